@@ -0,0 +1,94 @@
+#include "animation.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) +
+                   (p2 - p0) * t +
+                   (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+}
+
+CameraPath CameraPath::load(const std::string& file) {
+    std::ifstream input(file);
+    if (!input) {
+        throw std::runtime_error("Unable to open camera path " + file);
+    }
+
+    std::stringstream text;
+    text << input.rdbuf();
+    return parse(text.str(), file);
+}
+
+CameraPath CameraPath::parse(const std::string& text, const std::string& name) {
+    std::istringstream input(text);
+    CameraPath path;
+    path.source = text;
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        CameraKeyframe key;
+        if (!(fields >> key.time
+                     >> key.position.x >> key.position.y >> key.position.z
+                     >> key.target.x >> key.target.y >> key.target.z)) {
+            throw std::runtime_error("Malformed camera keyframe: " + line);
+        }
+        path.keyframes.push_back(key);
+    }
+
+    if (path.keyframes.empty()) {
+        throw std::runtime_error("Camera path " + name + " has no keyframes");
+    }
+
+    std::sort(path.keyframes.begin(), path.keyframes.end(), [](const CameraKeyframe& a, const CameraKeyframe& b) {
+        return a.time < b.time;
+    });
+    return path;
+}
+
+float CameraPath::duration() const {
+    return keyframes.back().time - keyframes.front().time;
+}
+
+int CameraPath::frameCount(float fps) const {
+    return static_cast<int>(duration() * fps) + 1;
+}
+
+void CameraPath::apply(float time, Camera& camera) const {
+    time += keyframes.front().time;
+
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const CameraKeyframe& key) {
+        return t < key.time;
+    });
+    if (next == keyframes.begin() || next == keyframes.end()) {
+        const CameraKeyframe& key = next == keyframes.begin() ? keyframes.front() : keyframes.back();
+        camera.position = key.position;
+        camera.target = key.target;
+        return;
+    }
+
+    // The spline goes through k1 and k2, the neighbours only shape it
+    size_t i2 = next - keyframes.begin();
+    size_t i1 = i2 - 1;
+    const CameraKeyframe& k0 = keyframes[i1 > 0 ? i1 - 1 : i1];
+    const CameraKeyframe& k1 = keyframes[i1];
+    const CameraKeyframe& k2 = keyframes[i2];
+    const CameraKeyframe& k3 = keyframes[std::min(i2 + 1, keyframes.size() - 1)];
+
+    float t = (time - k1.time) / (k2.time - k1.time);
+    camera.position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+    camera.target = catmullRom(k0.target, k1.target, k2.target, k3.target, t);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "camera.h"
+
+struct CameraKeyframe {
+  float time;
+  glm::vec3 position;
+  glm::vec3 target;
+};
+
+// Camera position/target keyframes, interpolated with a Catmull-Rom spline
+class CameraPath {
+public:
+  // One keyframe per line: time px py pz tx ty tz. Lines starting with # are ignored
+  static CameraPath load(const std::string& file);
+  // Same format, from text already in memory. `name` is only used in errors
+  static CameraPath parse(const std::string& text, const std::string& name);
+
+  float duration() const;
+  // Frames needed to cover the whole path, first and last keyframe included
+  int frameCount(float fps) const;
+
+  // The keyframes as they were read, to hand the path to another process
+  const std::string& text() const { return source; }
+
+  // Move the camera to where the path is at `time`
+  void apply(float time, Camera& camera) const;
+
+private:
+  std::vector<CameraKeyframe> keyframes;
+  std::string source;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include "color.h"
+#include "object.h"
+
+// Adaptive anti-aliasing: every pixel gets one sample through its centre,
+// and only pixels that differ from a neighbour get extra samples
+struct AntiAliasing {
+  int maxSamples = 1;           // per pixel, counting the centre one. 1 turns it off
+  int colorThreshold = 24;      // largest per-channel difference before a pixel counts as an edge
+  float normalThreshold = 0.9f; // smallest cosine between neighbouring normals
+};
+
+// What the centre sample of a pixel saw
+struct PixelSample {
+  Color color;
+  const Object* object = nullptr;  // nullptr for the sky
+  glm::vec3 normal{0.0f};
+};
+
+inline bool isEdge(const PixelSample& a, const PixelSample& b, const AntiAliasing& settings) {
+  if (a.object != b.object) {
+    return true;
+  }
+  if (a.object && glm::dot(a.normal, b.normal) < settings.normalThreshold) {
+    return true;
+  }
+  return std::abs(int(a.color.r) - int(b.color.r)) > settings.colorThreshold ||
+         std::abs(int(a.color.g) - int(b.color.g)) > settings.colorThreshold ||
+         std::abs(int(a.color.b) - int(b.color.b)) > settings.colorThreshold;
+}
+
+// `count` jittered offsets in [0, 1)^2, one per cell of a stratified grid.
+// The grid is rows x columns with exactly `count` cells, as square as
+// possible, so no part of the pixel is left without a sample.
+// Seeded from the pixel so every render of a frame gives the same image
+inline std::vector<glm::vec2> stratifiedOffsets(int count, int x, int y) {
+  int rows = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(count))));
+  while (count % rows != 0) {
+    rows--;
+  }
+  int columns = count / rows;
+
+  std::minstd_rand rng(static_cast<unsigned>(y) * 7919u + static_cast<unsigned>(x) + 1u);
+  std::uniform_real_distribution<float> jitter(0.0f, 1.0f);
+
+  std::vector<glm::vec2> offsets;
+  offsets.reserve(std::max(0, count));
+  for (int i = 0; i < count; i++) {
+    int cellX = i % columns;
+    int cellY = i / columns;
+    offsets.push_back(glm::vec2((cellX + jitter(rng)) / columns, (cellY + jitter(rng)) / rows));
+  }
+  return offsets;
+}
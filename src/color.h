@@ -25,6 +25,8 @@ struct Color {
         a = std::clamp(static_cast<Uint8>(alpha * 255), Uint8(0), Uint8(255));
     }
 
+    bool operator==(const Color& other) const = default;
+
     // Overload the + operator to add colors
     Color operator+(const Color& other) const {
         return Color(
@@ -6,6 +6,7 @@ Cube::Cube(const glm::vec3& minCorner, const glm::vec3& maxCorner, const Materia
 Intersect Cube::rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const {
     float tmin = (minCorner.x - rayOrigin.x) / rayDirection.x;
     float tmax = (maxCorner.x - rayOrigin.x) / rayDirection.x;
+    int axis = 0;  // axis of the slab the ray enters through
     
     if (tmin > tmax) {
         std::swap(tmin, tmax);
@@ -24,6 +25,7 @@ Intersect Cube::rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDir
     
     if (tymin > tmin) {
         tmin = tymin;
+        axis = 1;
     }
     
     if (tymax < tmax) {
@@ -43,6 +45,7 @@ Intersect Cube::rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDir
     
     if (tzmin > tmin) {
         tmin = tzmin;
+        axis = 2;
     }
     
     if (tzmax < tmax) {
@@ -53,42 +56,26 @@ Intersect Cube::rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDir
         return Intersect{false};
     }
     
-    glm::vec3 point = rayOrigin + tmin * rayDirection;
-    glm::vec3 normal = glm::normalize(point - minCorner);
+    // The hit face is the entering slab, the rest is left to getAttributes
+    return Intersect{true, tmin, axis};
+}
 
-    glm::vec3 center = (minCorner + maxCorner) / 2.0f;
-    float edgeLength = maxCorner.x - minCorner.x;
+HitAttributes Cube::getAttributes(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const Intersect& hit) const {
+    int axis = hit.id;
+    glm::vec3 point = rayOrigin + hit.dist * rayDirection;
 
-    glm::vec3 delta = rayOrigin + tmin * rayDirection - center;
-    glm::vec3 absDelta = glm::abs(delta);
+    // The face of the slab the ray entered through, facing against it
+    glm::vec3 normal(0.0f);
+    normal[axis] = rayDirection[axis] > 0 ? -1.0f : 1.0f;
 
-    // Determine which face was hit
-    if (absDelta.x > absDelta.y && absDelta.x > absDelta.z) {
-        normal = glm::vec3(delta.x > 0 ? 1 : -1, 0, 0);
-    } else if (absDelta.y > absDelta.z) {
-        normal = glm::vec3(0, delta.y > 0 ? 1 : -1, 0);
-    } else {
-        normal = glm::vec3(0, 0, delta.z > 0 ? 1 : -1);
-    }
-
-    // Calculate UV coordinates for the hit face
-    float tx, ty;
-    if (absDelta.x > absDelta.y && absDelta.x > absDelta.z) {
-        normal = glm::vec3(delta.x > 0 ? 1 : -1, 0, 0);
-        tx = (delta.y + edgeLength / 2) / edgeLength;
-        ty = (delta.z + edgeLength / 2) / edgeLength;
-    } else if (absDelta.y > absDelta.z) {
-        normal = glm::vec3(0, delta.y > 0 ? 1 : -1, 0);
-        tx = (delta.x + edgeLength / 2) / edgeLength;
-        ty = (delta.z + edgeLength / 2) / edgeLength;
-    } else {
-        normal = glm::vec3(0, 0, delta.z > 0 ? 1 : -1);
-        tx = (delta.x + edgeLength / 2) / edgeLength;
-        ty = (delta.y + edgeLength / 2) / edgeLength;
-    }
+    // UVs are taken relative to the unit grid rather than the box, so merged
+    // boxes keep the same per-block texture tiling as the cubes they replace
+    glm::vec3 local = point - minCorner;
+    int uAxis = axis == 0 ? 1 : 0;
+    int vAxis = axis == 2 ? 1 : 2;
 
-    tx = glm::clamp(tx, 0.0f, 1.0f);
-    ty = glm::clamp(ty, 0.0f, 1.0f);
+    float tx = glm::clamp(glm::fract(local[uAxis]), 0.0f, 1.0f);
+    float ty = glm::clamp(glm::fract(local[vAxis]), 0.0f, 1.0f);
 
-    return Intersect{true, tmin, point, normal, tx, ty};
-}
\ No newline at end of file
+    return HitAttributes{point, normal, tx, ty};
+}
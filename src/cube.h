@@ -10,6 +10,10 @@ public:
   Cube(const glm::vec3& minCorner, const glm::vec3& maxCorner, const Material& mat);
 
   Intersect rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const override;
+  HitAttributes getAttributes(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const Intersect& hit) const override;
+
+  const glm::vec3& getMinCorner() const { return minCorner; }
+  const glm::vec3& getMaxCorner() const { return maxCorner; }
 
 private:
   glm::vec3 minCorner;
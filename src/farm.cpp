@@ -0,0 +1,382 @@
+#include "farm.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <stdexcept>
+#include "print.h"
+
+namespace {
+
+const uint32_t MAGIC = 0x47435246;  // "GCRF"
+const uint32_t VERSION = 3;
+
+// Longest a peer may stall in the middle of a message before it is dropped
+const int RECEIVE_TIMEOUT_SECONDS = 5;
+
+// Largest camera path a worker accepts in the settings
+const uint32_t MAX_CAMERA_PATH_BYTES = 1 << 20;
+
+enum Message : uint32_t {
+    MSG_TILE = 1,
+    MSG_DONE = 2,
+    MSG_RESULT = 3,
+    MSG_SETTINGS = 4,
+};
+
+bool readAll(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = recv(fd, bytes, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool writeInts(int fd, std::initializer_list<uint32_t> values) {
+    uint32_t buffer[8];
+    size_t count = 0;
+    for (uint32_t value : values) {
+        buffer[count++] = htonl(value);
+    }
+    return writeAll(fd, buffer, count * sizeof(uint32_t));
+}
+
+bool readInts(int fd, uint32_t* values, size_t count) {
+    if (!readAll(fd, values, count * sizeof(uint32_t))) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        values[i] = ntohl(values[i]);
+    }
+    return true;
+}
+
+bool sendTile(int fd, const Tile& tile) {
+    return writeInts(fd, {MSG_TILE, uint32_t(tile.frame), uint32_t(tile.x), uint32_t(tile.y),
+                          uint32_t(tile.width), uint32_t(tile.height)});
+}
+
+bool sendSettings(int fd, const RenderSettings& settings) {
+    return writeInts(fd, {MSG_SETTINGS, uint32_t(settings.maxSamples), std::bit_cast<uint32_t>(settings.lodFootprint),
+                          std::bit_cast<uint32_t>(settings.fps), uint32_t(settings.cameraPath.size())}) &&
+           writeAll(fd, settings.cameraPath.data(), settings.cameraPath.size());
+}
+
+bool sameTile(const Tile& a, const Tile& b) {
+    return a.frame == b.frame && a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+struct Worker {
+    int fd;
+    bool busy = false;
+    Tile tile{};
+    std::chrono::steady_clock::time_point dispatched;  // when `tile` was sent
+};
+
+struct FrameState {
+    std::vector<Color> pixels;
+    int remaining = 0;
+};
+
+}
+
+RenderFarm::RenderFarm(int width, int height, int frames, int tileSize, int tileTimeout)
+  : width(width), height(height), frames(frames), tileSize(tileSize), tileTimeout(tileTimeout) {}
+
+void RenderFarm::run(int port, int localWorkers, const RenderSettings& settings, const TileRenderer& render,
+                     const FrameSink& sink) {
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error("Unable to create coordinator socket: " + std::string(strerror(errno)));
+    }
+
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 64) < 0) {
+        close(listenFd);
+        throw std::runtime_error("Unable to listen on port " + std::to_string(port) + ": " + std::string(strerror(errno)));
+    }
+
+    // Each child is its own process with a copy-on-write view of the scene,
+    // so workers never contend on shared memory
+    std::vector<pid_t> children;
+    for (int i = 0; i < localWorkers; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listenFd);
+            try {
+                runWorker("127.0.0.1", port, render);
+            } catch (const std::exception& e) {
+                print("Worker error:", e.what());
+                _exit(1);
+            }
+            _exit(0);
+        }
+        if (pid > 0) {
+            children.push_back(pid);
+        }
+    }
+
+    std::deque<Tile> pending;
+    std::map<int, FrameState> frameStates;
+    for (int frame = 0; frame < frames; frame++) {
+        FrameState& state = frameStates[frame];
+        for (int y = 0; y < height; y += tileSize) {
+            for (int x = 0; x < width; x += tileSize) {
+                pending.push_back(Tile{frame, x, y, std::min(tileSize, width - x), std::min(tileSize, height - y)});
+                state.remaining++;
+            }
+        }
+    }
+
+    std::vector<Worker> workers;
+    size_t tilesLeft = pending.size();
+
+    auto dropWorker = [&](size_t index) {
+        if (workers[index].busy) {
+            pending.push_front(workers[index].tile);
+            print("Render worker lost, reassigning its tile");
+        } else {
+            print("Render worker lost");
+        }
+        close(workers[index].fd);
+        workers.erase(workers.begin() + index);
+    };
+
+    while (tilesLeft > 0) {
+        // Keep every idle worker fed
+        for (size_t i = workers.size(); i-- > 0 && !pending.empty();) {
+            if (workers[i].busy) {
+                continue;
+            }
+            if (!sendTile(workers[i].fd, pending.front())) {
+                dropWorker(i);
+                continue;
+            }
+            workers[i].busy = true;
+            workers[i].tile = pending.front();
+            workers[i].dispatched = std::chrono::steady_clock::now();
+            pending.pop_front();
+        }
+
+        std::vector<pollfd> fds;
+        fds.push_back(pollfd{listenFd, POLLIN, 0});
+        for (const Worker& worker : workers) {
+            fds.push_back(pollfd{worker.fd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), 500) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Coordinator poll failed: " + std::string(strerror(errno)));
+        }
+
+        // Results from workers, walking backwards so dropping one is safe
+        for (size_t i = workers.size(); i-- > 0;) {
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+
+            uint32_t header[6];
+            if (!readInts(workers[i].fd, header, 6) || header[0] != MSG_RESULT) {
+                dropWorker(i);
+                continue;
+            }
+
+            // Only the tile the worker was given is accepted, anything else
+            // would write outside the frame or count a tile twice
+            Tile tile{int(header[1]), int(header[2]), int(header[3]), int(header[4]), int(header[5])};
+            if (!workers[i].busy || !sameTile(tile, workers[i].tile)) {
+                dropWorker(i);
+                continue;
+            }
+
+            std::vector<Uint8> rgb(size_t(tile.width) * tile.height * 3);
+            if (!readAll(workers[i].fd, rgb.data(), rgb.size())) {
+                dropWorker(i);
+                continue;
+            }
+            workers[i].busy = false;
+
+            auto state = frameStates.find(tile.frame);
+            if (state == frameStates.end()) {
+                continue;
+            }
+            if (state->second.pixels.empty()) {
+                state->second.pixels.resize(size_t(width) * height);
+            }
+            for (int y = 0; y < tile.height; y++) {
+                for (int x = 0; x < tile.width; x++) {
+                    const Uint8* p = &rgb[(size_t(y) * tile.width + x) * 3];
+                    state->second.pixels[size_t(tile.y + y) * width + tile.x + x] = Color(int(p[0]), int(p[1]), int(p[2]));
+                }
+            }
+
+            tilesLeft--;
+            state->second.remaining--;
+
+            // Hand frames over in order, holding back any that finish early
+            while (!frameStates.empty() && frameStates.begin()->second.remaining == 0) {
+                sink(frameStates.begin()->first, frameStates.begin()->second.pixels);
+                frameStates.erase(frameStates.begin());
+            }
+        }
+
+        // A worker that hung, or sits behind a partition that never resets the
+        // connection, would hold its tile forever
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = workers.size(); i-- > 0;) {
+            if (workers[i].busy && now - workers[i].dispatched > std::chrono::seconds(tileTimeout)) {
+                print("Render worker timed out on frame", workers[i].tile.frame);
+                dropWorker(i);
+            }
+        }
+
+        // New workers, local or remote
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                // A peer that never sends its hello, or stops halfway through
+                // a result, must not stall the whole farm
+                timeval timeout{RECEIVE_TIMEOUT_SECONDS, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                int keepAlive = 1;
+                setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(keepAlive));
+            }
+            uint32_t hello[2];
+            if (fd >= 0 && readInts(fd, hello, 2) && hello[0] == MAGIC && hello[1] == VERSION &&
+                sendSettings(fd, settings)) {
+                workers.push_back(Worker{fd});
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        // With no remote workers, running out of local ones means nobody is left.
+        // Only our own workers are reaped, the process may have other children
+        for (size_t i = children.size(); i-- > 0;) {
+            if (waitpid(children[i], nullptr, WNOHANG) > 0) {
+                children.erase(children.begin() + i);
+            }
+        }
+        if (workers.empty() && children.empty() && localWorkers > 0) {
+            close(listenFd);
+            throw std::runtime_error("All render workers were lost");
+        }
+    }
+
+    for (const Worker& worker : workers) {
+        writeInts(worker.fd, {MSG_DONE});
+        close(worker.fd);
+    }
+    close(listenFd);
+
+    for (pid_t child : children) {
+        waitpid(child, nullptr, 0);
+    }
+}
+
+void runWorker(const std::string& host, int port, const TileRenderer& render) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) {
+        throw std::runtime_error("Unable to resolve coordinator " + host);
+    }
+
+    int fd = -1;
+    for (addrinfo* candidate = result; candidate && fd < 0; candidate = candidate->ai_next) {
+        fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (fd >= 0 && connect(fd, candidate->ai_addr, candidate->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+
+    if (fd < 0 || !writeInts(fd, {MAGIC, VERSION})) {
+        throw std::runtime_error("Unable to connect to coordinator " + host + ":" + std::to_string(port));
+    }
+
+    RenderSettings settings;
+    std::vector<Color> pixels;
+    std::vector<Uint8> rgb;
+    uint32_t type;
+    while (readInts(fd, &type, 1) && (type == MSG_TILE || type == MSG_SETTINGS)) {
+        if (type == MSG_SETTINGS) {
+            uint32_t values[4];
+            if (!readInts(fd, values, 4) || values[3] > MAX_CAMERA_PATH_BYTES) {
+                break;
+            }
+            settings.maxSamples = int(values[0]);
+            settings.lodFootprint = std::bit_cast<float>(values[1]);
+            settings.fps = std::bit_cast<float>(values[2]);
+            settings.cameraPath.resize(values[3]);
+            if (!readAll(fd, settings.cameraPath.data(), settings.cameraPath.size())) {
+                break;
+            }
+            continue;
+        }
+
+        uint32_t fields[5];
+        if (!readInts(fd, fields, 5)) {
+            break;
+        }
+
+        Tile tile{int(fields[0]), int(fields[1]), int(fields[2]), int(fields[3]), int(fields[4])};
+        pixels.resize(size_t(tile.width) * tile.height);
+        render(tile, settings, pixels.data());
+
+        rgb.resize(pixels.size() * 3);
+        for (size_t i = 0; i < pixels.size(); i++) {
+            rgb[i * 3] = pixels[i].r;
+            rgb[i * 3 + 1] = pixels[i].g;
+            rgb[i * 3 + 2] = pixels[i].b;
+        }
+
+        if (!writeInts(fd, {MSG_RESULT, fields[0], fields[1], fields[2], fields[3], fields[4]}) ||
+            !writeAll(fd, rgb.data(), rgb.size())) {
+            break;
+        }
+    }
+
+    close(fd);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "color.h"
+
+// A rectangle of one frame, the unit of work handed to workers
+struct Tile {
+  int frame;
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// Options that change what a tile looks like. The coordinator sends its own
+// to every worker, so a frame never mixes tiles rendered differently
+struct RenderSettings {
+  int maxSamples = 1;         // anti-aliasing samples per pixel
+  float lodFootprint = 0.0f;  // octree LOD footprint, 0 for full detail
+  float fps = 30.0f;          // frame n is the camera path at n / fps
+  std::string cameraPath;     // keyframes, in the text format of CameraPath
+};
+
+// Worker side: trace the tile into `pixels` (width * height, row major)
+using TileRenderer = std::function<void(const Tile& tile, const RenderSettings& settings, Color* pixels)>;
+
+// Coordinator side: called once per frame, in frame order, once all its tiles are back
+using FrameSink = std::function<void(int frame, const std::vector<Color>& pixels)>;
+
+// Coordinator of a multi-process render. Tiles are handed out over TCP to
+// workers, which may be forked locally or started on other hosts with
+// runWorker(). A worker that disconnects, or holds a tile for longer than
+// `tileTimeout` seconds, is dropped and its tile given to another one.
+//
+// Protocol (all integers are 32 bit, network byte order):
+//   worker -> coordinator  HELLO    magic, version
+//   coordinator -> worker  SETTINGS maxSamples, lodFootprint, fps (float bits), path length,
+//                                   then the camera path text; once after HELLO
+//                          TILE     frame, x, y, width, height
+//                          DONE
+//   worker -> coordinator  RESULT   frame, x, y, width, height, then RGB bytes
+class RenderFarm {
+public:
+  RenderFarm(int width, int height, int frames, int tileSize = 64, int tileTimeout = 300);
+
+  // Listen on `port`, fork `localWorkers` workers that run `render`, hand
+  // `settings` to every worker that connects, and return once every frame has been assembled and passed to `sink`.
+  // Forking after the scene is set up means it is only loaded once.
+  void run(int port, int localWorkers, const RenderSettings& settings, const TileRenderer& render,
+           const FrameSink& sink);
+
+private:
+  int width;
+  int height;
+  int frames;
+  int tileSize;
+  int tileTimeout;
+};
+
+// Connect to a coordinator and render tiles until told to stop
+void runWorker(const std::string& host, int port, const TileRenderer& render);
@@ -0,0 +1,133 @@
+#include "framewriter.h"
+
+#include <SDL_image.h>
+#include <sys/wait.h>
+#include <csignal>
+#include <stdexcept>
+#include "ppm.h"
+
+FrameWriter::FrameWriter(const std::string& output, int width, int height, size_t capacity)
+  : output(output), width(width), height(height), capacity(capacity) {
+    if (!output.empty() && output[0] == '|') {
+        // An encoder that exits early must make fwrite fail with EPIPE
+        // instead of killing the process, so the error reaches finish()
+        signal(SIGPIPE, SIG_IGN);
+        pipe = popen(output.substr(1).c_str(), "w");
+        if (!pipe) {
+            throw std::runtime_error("Unable to start encoder: " + output.substr(1));
+        }
+    }
+    worker = std::thread(&FrameWriter::loop, this);
+}
+
+FrameWriter::~FrameWriter() {
+    try {
+        finish();
+    } catch (const std::exception&) {
+        // Errors are reported by an explicit finish(), nothing to do here
+    }
+}
+
+void FrameWriter::push(int frame, std::vector<Color>&& pixels) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [&] { return queue.size() < capacity || error; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    queue.emplace_back(frame, std::move(pixels));
+    notEmpty.notify_one();
+}
+
+void FrameWriter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    notEmpty.notify_one();
+
+    if (worker.joinable()) {
+        worker.join();
+    }
+    if (pipe) {
+        // An encoder can read every frame and still fail, e.g. on a bad output path
+        int status = pclose(pipe);
+        pipe = nullptr;
+        if (!error && status != 0) {
+            int code = status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : status;
+            throw std::runtime_error("Encoder " + output.substr(1) + " failed with status " + std::to_string(code));
+        }
+    }
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+void FrameWriter::loop() {
+    while (true) {
+        std::pair<int, std::vector<Color>> item;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [&] { return !queue.empty() || closing; });
+            if (queue.empty()) {
+                return;
+            }
+            item = std::move(queue.front());
+            queue.pop_front();
+        }
+        notFull.notify_one();
+
+        try {
+            write(item.first, item.second);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+            queue.clear();
+            notFull.notify_all();
+            return;
+        }
+    }
+}
+
+void FrameWriter::write(int frame, const std::vector<Color>& pixels) {
+    std::vector<Uint8> rgb(pixels.size() * 3);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        rgb[i * 3] = pixels[i].r;
+        rgb[i * 3 + 1] = pixels[i].g;
+        rgb[i * 3 + 2] = pixels[i].b;
+    }
+
+    if (pipe) {
+        if (fwrite(rgb.data(), 1, rgb.size(), pipe) != rgb.size()) {
+            throw std::runtime_error("Encoder pipe closed while writing frame " + std::to_string(frame));
+        }
+        return;
+    }
+
+    std::string path = framePath(frame);
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0) {
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(rgb.data(), width, height, 24, width * 3, SDL_PIXELFORMAT_RGB24);
+        if (!surface) {
+            throw std::runtime_error("Unable to create surface for " + path + ": " + std::string(SDL_GetError()));
+        }
+        int result = IMG_SavePNG(surface, path.c_str());
+        SDL_FreeSurface(surface);
+        if (result != 0) {
+            throw std::runtime_error("Unable to save " + path + ": " + std::string(IMG_GetError()));
+        }
+        return;
+    }
+
+    writePPM(path, width, height, pixels);
+}
+
+std::string FrameWriter::framePath(int frame) const {
+    char number[16];
+    snprintf(number, sizeof(number), "_%04d", frame);
+
+    size_t dot = output.find_last_of('.');
+    size_t slash = output.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return output + number + ".ppm";
+    }
+    return output.substr(0, dot) + number + output.substr(dot);
+}
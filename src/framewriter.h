@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "color.h"
+
+// Writes finished frames on a background thread so the tracer never waits
+// on disk or an encoder. The queue is bounded: push() only blocks when
+// `capacity` frames are already waiting.
+//
+// `output` selects the sink:
+//   "frames/shot.png"  -> frames/shot_0000.png, frames/shot_0001.png, ...
+//   "frames/shot.ppm"  -> same, as binary PPM
+//   "|ffmpeg ..."      -> raw RGB24 frames piped to the command's stdin
+class FrameWriter {
+public:
+  FrameWriter(const std::string& output, int width, int height, size_t capacity = 4);
+  ~FrameWriter();
+
+  void push(int frame, std::vector<Color>&& pixels);
+
+  // Wait for every queued frame to be written. Rethrows any write error
+  void finish();
+
+private:
+  void loop();
+  void write(int frame, const std::vector<Color>& pixels);
+  std::string framePath(int frame) const;
+
+  std::string output;
+  int width;
+  int height;
+  size_t capacity;
+  FILE* pipe = nullptr;
+
+  std::deque<std::pair<int, std::vector<Color>>> queue;
+  std::mutex mutex;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  bool closing = false;
+  std::exception_ptr error;
+  std::thread worker;
+};
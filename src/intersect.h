@@ -2,12 +2,18 @@
 
 #include <glm/glm.hpp>
 
+// Result of the distance-only test every candidate goes through.
+// Kept small so it is returned in registers
 struct Intersect {
   bool isIntersecting = false;
   float dist = 0.0f;
+  int id = 0;  // primitive specific, e.g. which face of a cube was hit
+};
+
+// Surface data, only computed for the closest hit
+struct HitAttributes {
   glm::vec3 point;
   glm::vec3 normal;
   float u = 0.0f;
   float v = 0.0f;
 };
-
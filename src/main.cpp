@@ -3,10 +3,13 @@
 #include <SDL_render.h>
 #include <SDL_image.h>
 #include <cstdlib>
+#include <optional>
 #include <glm/ext/quaternion_geometric.hpp>
 #include <glm/geometric.hpp>
+#include <array>
 #include <string>
 #include <glm/glm.hpp>
+#include <utility>
 #include <vector>
 #include <print.h>
 
@@ -17,15 +20,27 @@
 #include "light.h"
 #include "camera.h"
 #include "skybox.h"
+#include "world.h"
+#include "farm.h"
+#include "animation.h"
+#include "framewriter.h"
+#include "regression.h"
+#include "antialias.h"
 
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 const float ASPECT_RATIO = static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT);
 const int MAX_RECURSION_DEPTH = 3;
 const float SHADOW_BIAS = 0.0001f;
+const float FOV = 3.1415f / 3;
 
 SDL_Renderer* renderer;
-std::vector<Object*> objects;
+World world;
+std::vector<Material> palette;  // materials that can be placed at runtime
+size_t selectedMaterial = 0;
+uint64_t rayCount = 0;  // rays traced, for the regression suite's rays/s
+AntiAliasing antiAliasing;
+float lodFootprint = 0.0f;  // width a pixel covers per unit of distance, 0 keeps full detail
 Light light(glm::vec3(5, 4, 10), 1.0f, Color(255, 255, 255));
 Camera camera(glm::vec3(0.0, 0.0, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 10.0f);
 Skybox skybox("assets/sky.jpg");
@@ -36,97 +51,153 @@ void point(glm::vec2 position, Color color) {
 }
 
 
-float castShadow(const glm::vec3& shadowOrig, const glm::vec3& lightDir, const std::vector<Object*>& objects, Object* hitObject) {
-    for (auto& obj : objects) {
-        if (obj != hitObject) {
-            Intersect shadowIntersect = obj->rayIntersect(shadowOrig, lightDir);
-            if (shadowIntersect.isIntersecting && shadowIntersect.dist > 0) {  // zbuffer?
-                const float shadowIntensity = (1.0f - glm::min(1.0f, shadowIntersect.dist / glm::length(light.position - shadowOrig)));
-                return shadowIntensity;
-            }
-        }
+float castShadow(const glm::vec3& shadowOrig, const glm::vec3& lightDir, Object* hitObject) {
+    rayCount++;
+    Intersect shadowIntersect;
+    if (world.intersect(shadowOrig, lightDir, shadowIntersect, hitObject, 0.0f)) {
+        const float shadowIntensity = (1.0f - glm::min(1.0f, shadowIntersect.dist / glm::length(light.position - shadowOrig)));
+        return shadowIntensity;
     }
 
     return 1.0f;
 }
 
-Color castRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const short recursion = 0) {
-    float zBuffer = 99999;
-    Object* hitObject = nullptr;
-    Intersect intersect;
+Color castRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const short recursion = 0, PixelSample* sample = nullptr);
 
-    for (const auto& object : objects) {
-        Intersect i = object->rayIntersect(rayOrigin, rayDirection);
-        if (i.isIntersecting && i.dist < zBuffer) {
-            zBuffer = i.dist;
-            hitObject = object;
-            intersect = i;
-        }
-    }
+// Shading kernel for one combination of material features. Paths for
+// features the material lacks are compiled out, together with their branches
+template <unsigned Features>
+Color shade(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const short recursion,
+            Object* hitObject, const HitAttributes& hit) {
+    constexpr bool textured = Features & MATERIAL_TEXTURED;
+    constexpr bool reflective = Features & MATERIAL_REFLECTIVE;
+    constexpr bool refractive = Features & MATERIAL_REFRACTIVE;
+    constexpr bool specular = Features & MATERIAL_SPECULAR;
 
-    if (!intersect.isIntersecting || recursion >= MAX_RECURSION_DEPTH) {
-        return skybox.getColor(rayDirection);  // Sky color
-    }
+    const Material& mat = hitObject->material;
 
-    glm::vec3 lightDir = glm::normalize(light.position - intersect.point);
-    glm::vec3 viewDir = glm::normalize(rayOrigin - intersect.point);
-    glm::vec3 reflectDir = glm::reflect(-lightDir, intersect.normal);
+    glm::vec3 lightDir = glm::normalize(light.position - hit.point);
 
     float shadowIntensity = castShadow(
-        intersect.point + intersect.normal,
-        lightDir, objects, hitObject);
-
-    float diffuseLightIntensity = std::max(0.0f, glm::dot(intersect.normal, lightDir));
-    float specReflection = glm::dot(viewDir, reflectDir);
-
-    Material mat = hitObject->material;
-
-    float specLightIntensity = std::pow(std::max(0.0f, glm::dot(viewDir, reflectDir)), mat.specularCoefficient);
+        hit.point + hit.normal,
+        lightDir, hitObject);
 
-    Color diffuseLight = mat.diffuse * light.intensity * diffuseLightIntensity * mat.albedo * shadowIntensity;
+    float diffuseLightIntensity = std::max(0.0f, glm::dot(hit.normal, lightDir));
 
-    Color specularLight = light.color * light.intensity * specLightIntensity * mat.specularAlbedo * shadowIntensity;
-
-    // If the material has a texture, apply texture mapping
-    if (mat.texture != nullptr) {
+    Color diffuseLight;
+    if constexpr (textured) {
         int textureWidth = mat.texture->w;
         int textureHeight = mat.texture->h;
 
-        float u = intersect.u;
-        float v = intersect.v;
-
-        int texX = static_cast<int>(u * textureWidth) % textureWidth;
-        int texY = static_cast<int>(v * textureHeight) % textureHeight;    
+        int texX = static_cast<int>(hit.u * textureWidth) % textureWidth;
+        int texY = static_cast<int>(hit.v * textureHeight) % textureHeight;
 
         Uint8* pixels = static_cast<Uint8*>(mat.texture->pixels);
         Uint8 r = pixels[texY * mat.texture->pitch + texX * mat.texture->format->BytesPerPixel];
         Uint8 g = pixels[texY * mat.texture->pitch + texX * mat.texture->format->BytesPerPixel + 1];
         Uint8 b = pixels[texY * mat.texture->pitch + texX * mat.texture->format->BytesPerPixel + 2];
-        
-        diffuseLight = Color(r / 255.0f, g / 255.0f, b / 255.0f);
+
         diffuseLight = Color(r, g, b) * light.intensity * diffuseLightIntensity * mat.albedo * shadowIntensity;
+    } else {
+        diffuseLight = mat.diffuse * light.intensity * diffuseLightIntensity * mat.albedo * shadowIntensity;
+    }
+
+    Color color = diffuseLight;
+
+    glm::vec3 reflectDir;
+    if constexpr (specular || reflective) {
+        reflectDir = glm::reflect(-lightDir, hit.normal);
+    }
+
+    if constexpr (specular) {
+        glm::vec3 viewDir = glm::normalize(rayOrigin - hit.point);
+        float specDot = std::max(0.0f, glm::dot(viewDir, reflectDir));
+
+        // pow(0, c) is 0 for any positive exponent, and adds nothing
+        if (specDot > 0.0f || mat.specularCoefficient <= 0.0f) {
+            float specLightIntensity = std::pow(specDot, mat.specularCoefficient);
+            Color specularLight = light.color * light.intensity * specLightIntensity * mat.specularAlbedo * shadowIntensity;
+            color = color + specularLight;
+        }
+    }
+
+    if constexpr (reflective || refractive) {
+        color = color * (1 - mat.reflectivity - mat.transparency);
     }
 
     // If the material is reflective, cast a reflected ray
-    Color reflectedColor(0.0f, 0.0f, 0.0f);
-    if (mat.reflectivity > 0) {
-        glm::vec3 offsetOrigin = intersect.point + intersect.normal * SHADOW_BIAS;
-        reflectedColor = castRay(offsetOrigin, reflectDir, recursion + 1);
+    if constexpr (reflective) {
+        glm::vec3 offsetOrigin = hit.point + hit.normal * SHADOW_BIAS;
+        Color reflectedColor = castRay(offsetOrigin, reflectDir, recursion + 1);
+        color = color + reflectedColor * mat.reflectivity;
     }
 
     // If the material is refractive, cast a refracted ray
-    Color refractedColor(0.0f, 0.0f, 0.0f);
-    if (mat.transparency > 0) {
-        glm::vec3 refractDir = glm::refract(rayDirection, intersect.normal, mat.refractionIndex);
-        glm::vec3 offsetOrigin = intersect.point - intersect.normal * SHADOW_BIAS;
-        refractedColor = castRay(offsetOrigin, refractDir, recursion + 1);
+    if constexpr (refractive) {
+        glm::vec3 refractDir = glm::refract(rayDirection, hit.normal, mat.refractionIndex);
+        glm::vec3 offsetOrigin = hit.point - hit.normal * SHADOW_BIAS;
+        Color refractedColor = castRay(offsetOrigin, refractDir, recursion + 1);
+        color = color + refractedColor * mat.transparency;
     }
 
-    Color color = (diffuseLight + specularLight) * (1 - mat.reflectivity - mat.transparency) + reflectedColor * mat.reflectivity + refractedColor * mat.transparency;
-
     return color;
 }
 
+using ShadingKernel = Color (*)(const glm::vec3&, const glm::vec3&, const short, Object*, const HitAttributes&);
+
+template <unsigned... Features>
+constexpr std::array<ShadingKernel, sizeof...(Features)> makeShadingKernels(std::integer_sequence<unsigned, Features...>) {
+    return {&shade<Features>...};
+}
+
+// One kernel per feature combination, indexed by Material::features
+constexpr auto shadingKernels = makeShadingKernels(std::make_integer_sequence<unsigned, MATERIAL_FEATURE_COMBINATIONS>{});
+
+// Far geometry seen through a coarse octree node: diffuse only, with the
+// node's average colour and albedo and no shadow ray
+Color shadeVoxel(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const VoxelHit& voxel) {
+    glm::vec3 point = rayOrigin + rayDirection * voxel.dist;
+    glm::vec3 lightDir = glm::normalize(light.position - point);
+    float diffuseLightIntensity = std::max(0.0f, glm::dot(voxel.normal, lightDir));
+    return voxel.color * light.intensity * diffuseLightIntensity * voxel.albedo;
+}
+
+// `sample`, when given, gets the object and normal of the hit for anti-aliasing
+Color castRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const short recursion, PixelSample* sample) {
+    rayCount++;
+    Intersect intersect;
+    Object* hitObject;
+
+    // Primary rays may stop at a coarse level of the octree when LOD is on
+    if (recursion == 0 && lodFootprint > 0.0f) {
+        VoxelHit voxel;
+        hitObject = world.intersectLod(rayOrigin, rayDirection, lodFootprint, intersect, voxel);
+        if (intersect.isIntersecting && !hitObject) {
+            Color color = shadeVoxel(rayOrigin, rayDirection, voxel);
+            if (sample) {
+                sample->normal = voxel.normal;
+            }
+            return color;
+        }
+    } else {
+        hitObject = world.intersect(rayOrigin, rayDirection, intersect);
+    }
+
+    if (!intersect.isIntersecting || recursion >= MAX_RECURSION_DEPTH) {
+        return skybox.getColor(rayDirection);  // Sky color
+    }
+
+    // Point, normal and UVs are only worked out for the closest hit
+    HitAttributes hit = hitObject->getAttributes(rayOrigin, rayDirection, intersect);
+
+    if (sample) {
+        sample->object = hitObject;
+        sample->normal = hit.normal;
+    }
+
+    return shadingKernels[hitObject->material.features](rayOrigin, rayDirection, recursion, hitObject, hit);
+}
+
 
 void setUp() {
     Material rubber = {
@@ -221,135 +292,394 @@ void setUp() {
     //objects.push_back(new Cube(glm::vec3(-1.0f, 1.0f, 2.0f), glm::vec3(0.0f, 2.0f, 3.0f), cObsidiana));
 
     // obsidiana
-    objects.push_back(new Cube(glm::vec3(-1.0f, -3.0f, 0.0f), glm::vec3(0.0f, -2.0f, 1.0f), obsidiana));
-    objects.push_back(new Cube(glm::vec3(0.0f, -3.0f, 0.0f), glm::vec3(1.0f, -2.0f, 1.0f), obsidiana));
-    objects.push_back(new Cube(glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(-1.0f, -1.0f, 1.0f), obsidiana));
-    objects.push_back(new Cube(glm::vec3(-2.0f, -1.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 1.0f), cObsidiana));
-    objects.push_back(new Cube(glm::vec3(-2.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 1.0f), obsidiana));
-    objects.push_back(new Cube(glm::vec3(-1.0f, 2.0f, 0.0f), glm::vec3(0.0f, 3.0f, 1.0f), obsidiana));
-    objects.push_back(new Cube(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 3.0f, 1.0f), obsidiana));
-    objects.push_back(new Cube(glm::vec3(1.0f, -2.0f, 0.0f), glm::vec3(2.0f, -1.0f, 1.0f), cObsidiana));
-    objects.push_back(new Cube(glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(2.0f, 0.0f, 1.0f), obsidiana));
-    objects.push_back(new Cube(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(2.0f, 1.0f, 1.0f), cObsidiana));
+    world.addBlock(glm::vec3(-1.0f, -3.0f, 0.0f), glm::vec3(0.0f, -2.0f, 1.0f), obsidiana);
+    world.addBlock(glm::vec3(0.0f, -3.0f, 0.0f), glm::vec3(1.0f, -2.0f, 1.0f), obsidiana);
+    world.addBlock(glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(-1.0f, -1.0f, 1.0f), obsidiana);
+    world.addBlock(glm::vec3(-2.0f, -1.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 1.0f), cObsidiana);
+    world.addBlock(glm::vec3(-2.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 1.0f), obsidiana);
+    world.addBlock(glm::vec3(-1.0f, 2.0f, 0.0f), glm::vec3(0.0f, 3.0f, 1.0f), obsidiana);
+    world.addBlock(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 3.0f, 1.0f), obsidiana);
+    world.addBlock(glm::vec3(1.0f, -2.0f, 0.0f), glm::vec3(2.0f, -1.0f, 1.0f), cObsidiana);
+    world.addBlock(glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(2.0f, 0.0f, 1.0f), obsidiana);
+    world.addBlock(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(2.0f, 1.0f, 1.0f), cObsidiana);
 
     // bloque de oro
-    objects.push_back(new Cube(glm::vec3(-2.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 2.0f, 1.0f), oro));
+    world.addBlock(glm::vec3(-2.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 2.0f, 1.0f), oro);
 
     // lava
-    objects.push_back(new Cube(glm::vec3(-1.0f, -3.0f, 1.0f), glm::vec3(0.0f, -2.0f, 2.0f), lava));
-    objects.push_back(new Cube(glm::vec3(0.0f, -3.0f, 1.0f), glm::vec3(1.0f, -2.0f, 2.0f), lava));
+    world.addBlock(glm::vec3(-1.0f, -3.0f, 1.0f), glm::vec3(0.0f, -2.0f, 2.0f), lava);
+    world.addBlock(glm::vec3(0.0f, -3.0f, 1.0f), glm::vec3(1.0f, -2.0f, 2.0f), lava);
 
     // nether brick
-    objects.push_back(new Cube(glm::vec3(-2.0f, -3.0f, 1.0f), glm::vec3(-1.0f, -2.0f, 2.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-2.0f, -3.0f, 2.0f), glm::vec3(-1.0f, -2.0f, 3.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-1.0f, -3.0f, 2.0f), glm::vec3(0.0f, -2.0f, 3.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(0.0f, -3.0f, 2.0f), glm::vec3(1.0f, -2.0f, 3.0f), redNetherBrick));
+    world.addBlock(glm::vec3(-2.0f, -3.0f, 1.0f), glm::vec3(-1.0f, -2.0f, 2.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-2.0f, -3.0f, 2.0f), glm::vec3(-1.0f, -2.0f, 3.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-1.0f, -3.0f, 2.0f), glm::vec3(0.0f, -2.0f, 3.0f), redNetherBrick);
+    world.addBlock(glm::vec3(0.0f, -3.0f, 2.0f), glm::vec3(1.0f, -2.0f, 3.0f), redNetherBrick);
     
-    objects.push_back(new Cube(glm::vec3(-3.0f, 2.0f, 0.0f), glm::vec3(-2.0f, 3.0f, 1.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-2.0f, 2.0f, 0.0f), glm::vec3(-1.0f, 3.0f, 1.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-3.0f, 1.0f, 0.0f), glm::vec3(-2.0f, 2.0f, 1.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(-2.0f, 1.0f, 1.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -1.0f, 0.0f), glm::vec3(-2.0f, 0.0f, 1.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -2.0f, 0.0f), glm::vec3(-2.0f, -1.0f, 1.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -3.0f, 0.0f), glm::vec3(-2.0f, -2.0f, 1.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -3.0f, 1.0f), glm::vec3(-2.0f, -2.0f, 2.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -3.0f, 2.0f), glm::vec3(-2.0f, -2.0f, 3.0f), redNetherBrick));
+    world.addBlock(glm::vec3(-3.0f, 2.0f, 0.0f), glm::vec3(-2.0f, 3.0f, 1.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-2.0f, 2.0f, 0.0f), glm::vec3(-1.0f, 3.0f, 1.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-3.0f, 1.0f, 0.0f), glm::vec3(-2.0f, 2.0f, 1.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(-2.0f, 1.0f, 1.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-3.0f, -1.0f, 0.0f), glm::vec3(-2.0f, 0.0f, 1.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-3.0f, -2.0f, 0.0f), glm::vec3(-2.0f, -1.0f, 1.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-3.0f, -3.0f, 0.0f), glm::vec3(-2.0f, -2.0f, 1.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-3.0f, -3.0f, 1.0f), glm::vec3(-2.0f, -2.0f, 2.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-3.0f, -3.0f, 2.0f), glm::vec3(-2.0f, -2.0f, 3.0f), redNetherBrick);
     
-    objects.push_back(new Cube(glm::vec3(-4.0f, -3.0f, 3.0f), glm::vec3(-3.0f, -2.5f, 4.0f), netherBrick));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -3.0f, 3.0f), glm::vec3(-2.0f, -2.5f, 4.0f), netherBrick));
-    objects.push_back(new Cube(glm::vec3(-2.0f, -3.0f, 3.0f), glm::vec3(-1.0f, -2.5f, 4.0f), netherBrick));
-    objects.push_back(new Cube(glm::vec3(-1.0f, -3.0f, 3.0f), glm::vec3(0.0f, -2.5f, 4.0f), netherBrick));
-    objects.push_back(new Cube(glm::vec3(0.0f, -3.0f, 3.0f), glm::vec3(1.0f, -2.5f, 4.0f), netherBrick));
-    objects.push_back(new Cube(glm::vec3(1.0f, -3.0f, 3.0f), glm::vec3(2.0f, -2.5f, 4.0f), netherBrick));
-    objects.push_back(new Cube(glm::vec3(2.0f, -3.0f, 3.0f), glm::vec3(3.0f, -2.5f, 4.0f), netherBrick));
+    world.addBlock(glm::vec3(-4.0f, -3.0f, 3.0f), glm::vec3(-3.0f, -2.5f, 4.0f), netherBrick);
+    world.addBlock(glm::vec3(-3.0f, -3.0f, 3.0f), glm::vec3(-2.0f, -2.5f, 4.0f), netherBrick);
+    world.addBlock(glm::vec3(-2.0f, -3.0f, 3.0f), glm::vec3(-1.0f, -2.5f, 4.0f), netherBrick);
+    world.addBlock(glm::vec3(-1.0f, -3.0f, 3.0f), glm::vec3(0.0f, -2.5f, 4.0f), netherBrick);
+    world.addBlock(glm::vec3(0.0f, -3.0f, 3.0f), glm::vec3(1.0f, -2.5f, 4.0f), netherBrick);
+    world.addBlock(glm::vec3(1.0f, -3.0f, 3.0f), glm::vec3(2.0f, -2.5f, 4.0f), netherBrick);
+    world.addBlock(glm::vec3(2.0f, -3.0f, 3.0f), glm::vec3(3.0f, -2.5f, 4.0f), netherBrick);
 
-    objects.push_back(new Cube(glm::vec3(-4.0f, -3.0f, 2.0f), glm::vec3(-3.0f, -2.0f, 3.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-4.0f, -3.0f, 1.0f), glm::vec3(-3.0f, -2.0f, 2.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-4.0f, -3.0f, 0.0f), glm::vec3(-3.0f, -2.0f, 1.0f), redNetherBrick));
-    objects.push_back(new Cube(glm::vec3(-4.0f, -3.0f, -1.0f), glm::vec3(-3.0f, -2.0f, 0.0f), redNetherBrick));
+    world.addBlock(glm::vec3(-4.0f, -3.0f, 2.0f), glm::vec3(-3.0f, -2.0f, 3.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-4.0f, -3.0f, 1.0f), glm::vec3(-3.0f, -2.0f, 2.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-4.0f, -3.0f, 0.0f), glm::vec3(-3.0f, -2.0f, 1.0f), redNetherBrick);
+    world.addBlock(glm::vec3(-4.0f, -3.0f, -1.0f), glm::vec3(-3.0f, -2.0f, 0.0f), redNetherBrick);
 
 
     // netherrack
-    objects.push_back(new Cube(glm::vec3(1.0f, -3.0f, 1.0f), glm::vec3(2.0f, -2.0f, 2.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(1.0f, -3.0f, 0.0f), glm::vec3(2.0f, -2.0f, 1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(1.0f, -3.0f, 2.0f), glm::vec3(2.0f, -2.0f, 3.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(2.0f, -3.0f, 1.0f), glm::vec3(3.0f, -2.0f, 2.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(2.0f, -3.0f, 0.0f), glm::vec3(3.0f, -2.0f, 1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(2.0f, -3.0f, 2.0f), glm::vec3(3.0f, -2.0f, 3.0f), netherrack));
+    world.addBlock(glm::vec3(1.0f, -3.0f, 1.0f), glm::vec3(2.0f, -2.0f, 2.0f), netherrack);
+    world.addBlock(glm::vec3(1.0f, -3.0f, 0.0f), glm::vec3(2.0f, -2.0f, 1.0f), netherrack);
+    world.addBlock(glm::vec3(1.0f, -3.0f, 2.0f), glm::vec3(2.0f, -2.0f, 3.0f), netherrack);
+    world.addBlock(glm::vec3(2.0f, -3.0f, 1.0f), glm::vec3(3.0f, -2.0f, 2.0f), netherrack);
+    world.addBlock(glm::vec3(2.0f, -3.0f, 0.0f), glm::vec3(3.0f, -2.0f, 1.0f), netherrack);
+    world.addBlock(glm::vec3(2.0f, -3.0f, 2.0f), glm::vec3(3.0f, -2.0f, 3.0f), netherrack);
     
-    objects.push_back(new Cube(glm::vec3(2.0f, -3.0f, -2.0f), glm::vec3(3.0f, -2.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(2.0f, -3.0f, -1.0f), glm::vec3(3.0f, -2.0f, 0.0f), netherrack));   
-    objects.push_back(new Cube(glm::vec3(1.0f, -3.0f, -1.0f), glm::vec3(2.0f, -2.0f, 0.0f), netherrack));   
-    objects.push_back(new Cube(glm::vec3(1.0f, -3.0f, -2.0f), glm::vec3(2.0f, -2.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(0.0f, -3.0f, -1.0f), glm::vec3(1.0f, -2.0f, 0.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(0.0f, -3.0f, -2.0f), glm::vec3(1.0f, -2.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-1.0f, -3.0f, -1.0f), glm::vec3(0.0f, -2.0f, 0.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-1.0f, -3.0f, -2.0f), glm::vec3(0.0f, -2.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-2.0f, -3.0f, -1.0f), glm::vec3(-1.0f, -2.0f, 0.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-2.0f, -3.0f, -2.0f), glm::vec3(-1.0f, -2.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -3.0f, -1.0f), glm::vec3(-2.0f, -2.0f, 0.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -3.0f, -2.0f), glm::vec3(-2.0f, -2.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-4.0f, -3.0f, -2.0f), glm::vec3(-3.0f, -2.0f, -1.0f), netherrack));
-    
-    objects.push_back(new Cube(glm::vec3(-5.0f, -4.0f, -2.0f), glm::vec3(-4.0f, -3.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-5.0f, -4.0f, -1.0f), glm::vec3(-4.0f, -3.0f, 0.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-5.0f, -4.0f, 0.0f), glm::vec3(-4.0f, -3.0f, 1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-5.0f, -4.0f, 1.0f), glm::vec3(-4.0f, -3.0f, 2.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-5.0f, -4.0f, 2.0f), glm::vec3(-4.0f, -3.0f, 3.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-5.0f, -4.0f, 3.0f), glm::vec3(-4.0f, -3.0f, 4.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-5.0f, -4.0f, 4.0f), glm::vec3(-4.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-4.0f, -4.0f, 4.0f), glm::vec3(-3.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -4.0f, 4.0f), glm::vec3(-2.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-2.0f, -4.0f, 4.0f), glm::vec3(-1.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-1.0f, -4.0f, 4.0f), glm::vec3(0.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(0.0f, -4.0f, 4.0f), glm::vec3(1.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(1.0f, -4.0f, 4.0f), glm::vec3(2.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(2.0f, -4.0f, 4.0f), glm::vec3(3.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(3.0f, -4.0f, 4.0f), glm::vec3(4.0f, -3.0f, 5.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(3.0f, -4.0f, 3.0f), glm::vec3(4.0f, -3.0f, 4.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(3.0f, -4.0f, 2.0f), glm::vec3(4.0f, -3.0f, 3.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(3.0f, -4.0f, 1.0f), glm::vec3(4.0f, -3.0f, 2.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(3.0f, -4.0f, 0.0f), glm::vec3(4.0f, -3.0f, 1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(3.0f, -4.0f, -1.0f), glm::vec3(4.0f, -3.0f, 0.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(3.0f, -4.0f, -2.0f), glm::vec3(4.0f, -3.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(2.0f, -4.0f, -2.0f), glm::vec3(3.0f, -3.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(1.0f, -4.0f, -2.0f), glm::vec3(2.0f, -3.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(0.0f, -4.0f, -2.0f), glm::vec3(1.0f, -3.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-1.0f, -4.0f, -2.0f), glm::vec3(0.0f, -3.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-2.0f, -4.0f, -2.0f), glm::vec3(-1.0f, -3.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-3.0f, -4.0f, -2.0f), glm::vec3(-2.0f, -3.0f, -1.0f), netherrack));
-    objects.push_back(new Cube(glm::vec3(-4.0f, -4.0f, -2.0f), glm::vec3(-3.0f, -3.0f, -1.0f), netherrack));
+    world.addBlock(glm::vec3(2.0f, -3.0f, -2.0f), glm::vec3(3.0f, -2.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(2.0f, -3.0f, -1.0f), glm::vec3(3.0f, -2.0f, 0.0f), netherrack);   
+    world.addBlock(glm::vec3(1.0f, -3.0f, -1.0f), glm::vec3(2.0f, -2.0f, 0.0f), netherrack);   
+    world.addBlock(glm::vec3(1.0f, -3.0f, -2.0f), glm::vec3(2.0f, -2.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(0.0f, -3.0f, -1.0f), glm::vec3(1.0f, -2.0f, 0.0f), netherrack);
+    world.addBlock(glm::vec3(0.0f, -3.0f, -2.0f), glm::vec3(1.0f, -2.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-1.0f, -3.0f, -1.0f), glm::vec3(0.0f, -2.0f, 0.0f), netherrack);
+    world.addBlock(glm::vec3(-1.0f, -3.0f, -2.0f), glm::vec3(0.0f, -2.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-2.0f, -3.0f, -1.0f), glm::vec3(-1.0f, -2.0f, 0.0f), netherrack);
+    world.addBlock(glm::vec3(-2.0f, -3.0f, -2.0f), glm::vec3(-1.0f, -2.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-3.0f, -3.0f, -1.0f), glm::vec3(-2.0f, -2.0f, 0.0f), netherrack);
+    world.addBlock(glm::vec3(-3.0f, -3.0f, -2.0f), glm::vec3(-2.0f, -2.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-4.0f, -3.0f, -2.0f), glm::vec3(-3.0f, -2.0f, -1.0f), netherrack);
     
+    world.addBlock(glm::vec3(-5.0f, -4.0f, -2.0f), glm::vec3(-4.0f, -3.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-5.0f, -4.0f, -1.0f), glm::vec3(-4.0f, -3.0f, 0.0f), netherrack);
+    world.addBlock(glm::vec3(-5.0f, -4.0f, 0.0f), glm::vec3(-4.0f, -3.0f, 1.0f), netherrack);
+    world.addBlock(glm::vec3(-5.0f, -4.0f, 1.0f), glm::vec3(-4.0f, -3.0f, 2.0f), netherrack);
+    world.addBlock(glm::vec3(-5.0f, -4.0f, 2.0f), glm::vec3(-4.0f, -3.0f, 3.0f), netherrack);
+    world.addBlock(glm::vec3(-5.0f, -4.0f, 3.0f), glm::vec3(-4.0f, -3.0f, 4.0f), netherrack);
+    world.addBlock(glm::vec3(-5.0f, -4.0f, 4.0f), glm::vec3(-4.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(-4.0f, -4.0f, 4.0f), glm::vec3(-3.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(-3.0f, -4.0f, 4.0f), glm::vec3(-2.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(-2.0f, -4.0f, 4.0f), glm::vec3(-1.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(-1.0f, -4.0f, 4.0f), glm::vec3(0.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(0.0f, -4.0f, 4.0f), glm::vec3(1.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(1.0f, -4.0f, 4.0f), glm::vec3(2.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(2.0f, -4.0f, 4.0f), glm::vec3(3.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(3.0f, -4.0f, 4.0f), glm::vec3(4.0f, -3.0f, 5.0f), netherrack);
+    world.addBlock(glm::vec3(3.0f, -4.0f, 3.0f), glm::vec3(4.0f, -3.0f, 4.0f), netherrack);
+    world.addBlock(glm::vec3(3.0f, -4.0f, 2.0f), glm::vec3(4.0f, -3.0f, 3.0f), netherrack);
+    world.addBlock(glm::vec3(3.0f, -4.0f, 1.0f), glm::vec3(4.0f, -3.0f, 2.0f), netherrack);
+    world.addBlock(glm::vec3(3.0f, -4.0f, 0.0f), glm::vec3(4.0f, -3.0f, 1.0f), netherrack);
+    world.addBlock(glm::vec3(3.0f, -4.0f, -1.0f), glm::vec3(4.0f, -3.0f, 0.0f), netherrack);
+    world.addBlock(glm::vec3(3.0f, -4.0f, -2.0f), glm::vec3(4.0f, -3.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(2.0f, -4.0f, -2.0f), glm::vec3(3.0f, -3.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(1.0f, -4.0f, -2.0f), glm::vec3(2.0f, -3.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(0.0f, -4.0f, -2.0f), glm::vec3(1.0f, -3.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-1.0f, -4.0f, -2.0f), glm::vec3(0.0f, -3.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-2.0f, -4.0f, -2.0f), glm::vec3(-1.0f, -3.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-3.0f, -4.0f, -2.0f), glm::vec3(-2.0f, -3.0f, -1.0f), netherrack);
+    world.addBlock(glm::vec3(-4.0f, -4.0f, -2.0f), glm::vec3(-3.0f, -3.0f, -1.0f), netherrack);
+
+    palette = {obsidiana, cObsidiana, oro, netherBrick, redNetherBrick, lava, netherrack};
+
+    // Merge the blocks into larger boxes before rendering
+    world.update();
+}
+
+// Cell of the block under the centre of the screen, or of the empty cell in
+// front of its face when `adjacent` is set
+bool targetCell(glm::ivec3& cell, bool adjacent) {
+    glm::vec3 direction = glm::normalize(camera.target - camera.position);
+
+    Intersect intersect;
+    Object* object = world.intersect(camera.position, direction, intersect, nullptr, 0.0f);
+    if (!object) {
+        return false;
+    }
+
+    HitAttributes hit = object->getAttributes(camera.position, direction, intersect);
+    cell = glm::ivec3(glm::floor(hit.point + hit.normal * (adjacent ? 0.5f : -0.5f)));
+    return true;
+}
+
+// Trace the rays of a rectangle of the screen into `pixels`, row by row
+void renderTile(int x0, int y0, int width, int height, Color* pixels) {
+    glm::vec3 cameraDir = glm::normalize(camera.target - camera.position);
+    glm::vec3 cameraX = glm::normalize(glm::cross(cameraDir, camera.up));
+    glm::vec3 cameraY = glm::normalize(glm::cross(cameraX, cameraDir));
+
+    // Direction of the ray through a point of the screen, in pixels
+    auto rayThrough = [&](float pixelX, float pixelY) {
+        float screenX = (2.0f * pixelX) / SCREEN_WIDTH - 1.0f;
+        float screenY = -(2.0f * pixelY) / SCREEN_HEIGHT + 1.0f;
+        screenX *= ASPECT_RATIO;
+        screenX *= tan(FOV/2.0f);
+        screenY *= tan(FOV/2.0f);
+
+        return glm::normalize(
+            cameraDir + cameraX * screenX + cameraY * screenY
+        );
+    };
+
+    if (antiAliasing.maxSamples <= 1) {
+        for (int y = y0; y < y0 + height; y++) {
+            for (int x = x0; x < x0 + width; x++) {
+                pixels[(y - y0) * width + (x - x0)] = castRay(camera.position, rayThrough(x + 0.5f, y + 0.5f));
+            }
+        }
+        return;
+    }
+
+    // One sample per pixel first, with a one pixel apron so edges on the
+    // tile border are found the same way as inside it
+    int apronX0 = std::max(0, x0 - 1);
+    int apronY0 = std::max(0, y0 - 1);
+    int apronX1 = std::min(SCREEN_WIDTH, x0 + width + 1);
+    int apronY1 = std::min(SCREEN_HEIGHT, y0 + height + 1);
+    int apronWidth = apronX1 - apronX0;
+
+    std::vector<PixelSample> samples(apronWidth * (apronY1 - apronY0));
+    for (int y = apronY0; y < apronY1; y++) {
+        for (int x = apronX0; x < apronX1; x++) {
+            PixelSample& sample = samples[(y - apronY0) * apronWidth + (x - apronX0)];
+            sample.color = castRay(camera.position, rayThrough(x + 0.5f, y + 0.5f), 0, &sample);
+        }
+    }
+
+    // Then extra stratified samples, only where a neighbour differs
+    const int neighbourX[] = {-1, 1, 0, 0};
+    const int neighbourY[] = {0, 0, -1, 1};
+    int extraSamples = antiAliasing.maxSamples - 1;
+
+    for (int y = y0; y < y0 + height; y++) {
+        for (int x = x0; x < x0 + width; x++) {
+            const PixelSample& centre = samples[(y - apronY0) * apronWidth + (x - apronX0)];
+
+            bool edge = false;
+            for (int i = 0; i < 4 && !edge; i++) {
+                int nx = x + neighbourX[i];
+                int ny = y + neighbourY[i];
+                if (nx >= apronX0 && nx < apronX1 && ny >= apronY0 && ny < apronY1) {
+                    edge = isEdge(centre, samples[(ny - apronY0) * apronWidth + (nx - apronX0)], antiAliasing);
+                }
+            }
+
+            if (!edge) {
+                pixels[(y - y0) * width + (x - x0)] = centre.color;
+                continue;
+            }
+
+            int r = centre.color.r;
+            int g = centre.color.g;
+            int b = centre.color.b;
+            for (const glm::vec2& offset : stratifiedOffsets(extraSamples, x, y)) {
+                Color color = castRay(camera.position, rayThrough(x + offset.x, y + offset.y));
+                r += color.r;
+                g += color.g;
+                b += color.b;
+            }
+
+            int count = extraSamples + 1;
+            pixels[(y - y0) * width + (x - x0)] = Color(r / count, g / count, b / count);
+        }
+    }
 }
 
 void render() {
-    float fov = 3.1415/3;
+    std::vector<Color> frame(SCREEN_WIDTH * SCREEN_HEIGHT);
+    renderTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, frame.data());
+
     for (int y = 0; y < SCREEN_HEIGHT; y++) {
         for (int x = 0; x < SCREEN_WIDTH; x++) {
-            float screenX = (2.0f * (x + 0.5f)) / SCREEN_WIDTH - 1.0f;
-            float screenY = -(2.0f * (y + 0.5f)) / SCREEN_HEIGHT + 1.0f;
-            screenX *= ASPECT_RATIO;
-            screenX *= tan(fov/2.0f);
-            screenY *= tan(fov/2.0f);
+            point(glm::vec2(x, y), frame[y * SCREEN_WIDTH + x]);
+        }
+    }
+}
+
+// Scenes of the regression suite. The diorama ones reuse the world built by
+// setUp(); the stress ones replace it, so they go last
+std::vector<RegressionScene> regressionScenes() {
+    Camera start = camera;
+
+    return {
+        {"diorama", [=] { camera = start; }},
+        {"diorama_side", [=] {
+            camera = start;
+            camera.rotate(4.0f, 0.0f);
+        }},
+        {"floor", [=] {
+            // Wide open floor with pillars: many chunks, mostly merged boxes
+            world = World();
+            for (int x = -24; x < 24; x++) {
+                for (int z = -24; z < 24; z++) {
+                    world.placeBlock(glm::ivec3(x, -4, z), palette[6]);
+                    if (x % 8 == 0 && z % 8 == 0) {
+                        for (int y = -3; y < 0; y++) {
+                            world.placeBlock(glm::ivec3(x, y, z), palette[2]);
+                        }
+                    }
+                }
+            }
+            world.update();
+            camera = Camera(glm::vec3(0.0f, 4.0f, 20.0f), glm::vec3(0.0f, -4.0f, 0.0f), start.up, start.rotationSpeed);
+        }},
+        {"checker", [=] {
+            // Alternating materials defeat merging, lava adds refraction
+            world = World();
+            for (int x = -12; x < 12; x++) {
+                for (int z = -12; z < 12; z++) {
+                    world.placeBlock(glm::ivec3(x, -4, z), palette[(x + z) & 1]);
+                    if (z == 0) {
+                        world.placeBlock(glm::ivec3(x, -3, z), palette[5]);
+                    }
+                }
+            }
+            world.update();
+            camera = Camera(glm::vec3(0.0f, 3.0f, 14.0f), glm::vec3(0.0f, -4.0f, 0.0f), start.up, start.rotationSpeed);
+        }},
+    };
+}
 
+// Modes without a window:
+//   GAME --farm <port> <localWorkers> <keyframes> <fps> <output>
+//   GAME --worker <host> <port>
+//   GAME --path <keyframes> <fps> <output>
+//   GAME --record <dir>
+//   GAME --check <dir> [tolerance] [perfMargin]
+// <output> is a file name pattern (.png/.ppm) or "|command" to pipe raw frames.
+// Any mode also takes --aa <maxSamples> for adaptive anti-aliasing and
+// --lod <pixels> to let primary rays stop at octree nodes narrower than that
+int runHeadless(int argc, char* argv[]) {
+    std::string mode = argv[1];
 
-            glm::vec3 cameraDir = glm::normalize(camera.target - camera.position);
+    setUp();
 
-            glm::vec3 cameraX = glm::normalize(glm::cross(cameraDir, camera.up));
-            glm::vec3 cameraY = glm::normalize(glm::cross(cameraX, cameraDir));
-            glm::vec3 rayDirection = glm::normalize(
-                cameraDir + cameraX * screenX + cameraY * screenY
-            );
-           
-            Color pixelColor = castRay(camera.position, rayDirection);
-            /* Color pixelColor = castRay(glm::vec3(0,0,20), glm::normalize(glm::vec3(screenX, screenY, -1.0f))); */
+    // Frame n of a farm render is the coordinator's camera path at n / fps,
+    // rendered with its settings. The path is only parsed again when it changes
+    std::optional<CameraPath> farmPath;
+    std::string farmPathText;
+    TileRenderer renderFrameTile = [&](const Tile& tile, const RenderSettings& settings, Color* pixels) {
+        antiAliasing.maxSamples = settings.maxSamples;
+        lodFootprint = settings.lodFootprint;
+        if (!farmPath || settings.cameraPath != farmPathText) {
+            farmPath = CameraPath::parse(settings.cameraPath, "from the coordinator");
+            farmPathText = settings.cameraPath;
+        }
+        farmPath->apply(tile.frame / settings.fps, camera);
+        renderTile(tile.x, tile.y, tile.width, tile.height, pixels);
+    };
 
-            point(glm::vec2(x, y), pixelColor);
+    try {
+        if (mode == "--farm" && argc >= 7) {
+            CameraPath path = CameraPath::load(argv[4]);
+            RenderSettings settings{antiAliasing.maxSamples, lodFootprint, std::stof(argv[5]), path.text()};
+            RenderFarm farm(SCREEN_WIDTH, SCREEN_HEIGHT, path.frameCount(settings.fps));
+
+            // Opened with the first frame, once the local workers are forked, so
+            // they fork from a single-threaded process and don't inherit the encoder pipe
+            std::optional<FrameWriter> writer;
+            farm.run(std::stoi(argv[2]), std::stoi(argv[3]), settings, renderFrameTile,
+                     [&](int frame, const std::vector<Color>& pixels) {
+                if (!writer) {
+                    writer.emplace(argv[6], SCREEN_WIDTH, SCREEN_HEIGHT);
+                }
+                writer->push(frame, std::vector<Color>(pixels));
+                print("Frame", frame, "done");
+            });
+            if (writer) {
+                writer->finish();
+            }
+            return 0;
         }
+
+        if (mode == "--path" && argc >= 5) {
+            CameraPath path = CameraPath::load(argv[2]);
+            float fps = std::stof(argv[3]);
+            int frames = path.frameCount(fps);
+            FrameWriter writer(argv[4], SCREEN_WIDTH, SCREEN_HEIGHT);
+
+            for (int frame = 0; frame < frames; frame++) {
+                path.apply(frame / fps, camera);
+
+                std::vector<Color> pixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+                renderTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, pixels.data());
+
+                // Frame N is written in the background while N+1 is traced
+                writer.push(frame, std::move(pixels));
+            }
+            writer.finish();
+            print(frames, "frames rendered");
+            return 0;
+        }
+
+        if ((mode == "--record" || mode == "--check") && argc >= 3) {
+            FrameRenderer renderFrame = [](std::vector<Color>& pixels) {
+                rayCount = 0;
+                renderTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, pixels.data());
+                return rayCount;
+            };
+
+            RegressionOptions options;
+            if (argc >= 4) {
+                options.tolerance = std::stoi(argv[3]);
+            }
+            if (argc >= 5) {
+                options.perfMargin = std::stof(argv[4]);
+            }
+
+            if (mode == "--record") {
+                recordBaselines(regressionScenes(), argv[2], SCREEN_WIDTH, SCREEN_HEIGHT, renderFrame, options);
+                return 0;
+            }
+            return checkBaselines(regressionScenes(), argv[2], SCREEN_WIDTH, SCREEN_HEIGHT, renderFrame, options) == 0 ? 0 : 1;
+        }
+
+        if (mode == "--worker" && argc >= 4) {
+            runWorker(argv[2], std::stoi(argv[3]), renderFrameTile);
+            return 0;
+        }
+    } catch (const std::exception& e) {
+        SDL_Log("%s", e.what());
+        return 1;
     }
+
+    SDL_Log("Usage: %s [--farm <port> <localWorkers> <keyframes> <fps> <output> | --worker <host> <port> | --path <keyframes> <fps> <output> | --record <dir> | --check <dir> [tolerance] [perfMargin]]", argv[0]);
+    return 1;
 }
 
 int main(int argc, char* argv[]) {
+    // Options shared by every mode, taken out before picking the mode
+    std::vector<char*> args(argv, argv + argc);
+    for (size_t i = 1; i + 1 < args.size();) {
+        if (std::string(args[i]) == "--aa") {
+            antiAliasing.maxSamples = std::stoi(args[i + 1]);
+            args.erase(args.begin() + i, args.begin() + i + 2);
+        } else if (std::string(args[i]) == "--lod") {
+            // Node widths are compared against the footprint times distance
+            lodFootprint = std::stof(args[i + 1]) * 2.0f * tan(FOV / 2.0f) / SCREEN_HEIGHT;
+            args.erase(args.begin() + i, args.begin() + i + 2);
+        } else {
+            i++;
+        }
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+
+    if (argc > 1) {
+        return runHeadless(argc, argv);
+    }
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         SDL_Log("Unable to initialize SDL: %s", SDL_GetError());
@@ -379,6 +709,7 @@ int main(int argc, char* argv[]) {
     }
 
     bool running = true;
+    glm::ivec3 cell;
     SDL_Event event;
 
     int frameCount = 0;
@@ -407,12 +738,35 @@ int main(int argc, char* argv[]) {
                     case SDLK_RIGHT:
                         camera.rotate(1.0f, 0.0f);
                         break;
+                    // Block editing: break, place, re-material, next material
+                    case SDLK_b:
+                        if (targetCell(cell, false)) {
+                            world.removeBlock(cell);
+                        }
+                        break;
+                    case SDLK_p:
+                        if (targetCell(cell, true)) {
+                            world.placeBlock(cell, palette[selectedMaterial]);
+                        }
+                        break;
+                    case SDLK_m:
+                        if (targetCell(cell, false)) {
+                            world.setMaterial(cell, palette[selectedMaterial]);
+                        }
+                        break;
+                    case SDLK_n:
+                        selectedMaterial = (selectedMaterial + 1) % palette.size();
+                        break;
                  }
             }
 
 
         }
 
+        // Edits show up this frame, only the chunks they touched are rebuilt.
+        // update() is cheap when nothing is dirty, so it runs every frame
+        world.update();
+
         // Clear the screen
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
@@ -2,6 +2,16 @@
 
 #include "color.h"
 
+// Shading features, each one selects a code path of the shading kernel
+enum MaterialFeature : unsigned {
+  MATERIAL_TEXTURED = 1 << 0,
+  MATERIAL_REFLECTIVE = 1 << 1,
+  MATERIAL_REFRACTIVE = 1 << 2,
+  MATERIAL_SPECULAR = 1 << 3,
+};
+
+const unsigned MATERIAL_FEATURE_COMBINATIONS = 1 << 4;
+
 struct Material {
   Color diffuse;
   float albedo;
@@ -11,4 +21,21 @@ struct Material {
   float transparency; // The transparency of the material
   float refractionIndex;
   SDL_Surface* texture = nullptr;
+  unsigned features = 0;  // MaterialFeature flags, filled in by classify()
+
+  void classify() {
+    features = (texture != nullptr ? MATERIAL_TEXTURED : 0u) |
+               (reflectivity > 0 ? MATERIAL_REFLECTIVE : 0u) |
+               (transparency > 0 ? MATERIAL_REFRACTIVE : 0u) |
+               (specularAlbedo > 0 ? MATERIAL_SPECULAR : 0u);
+  }
+
+  // Features are derived from the other fields, so a classified material
+  // still equals the unclassified copy it was made from
+  bool operator==(const Material& other) const {
+    return diffuse == other.diffuse && albedo == other.albedo && specularAlbedo == other.specularAlbedo &&
+           specularCoefficient == other.specularCoefficient && reflectivity == other.reflectivity &&
+           transparency == other.transparency && refractionIndex == other.refractionIndex &&
+           texture == other.texture;
+  }
 };
@@ -6,8 +6,11 @@
 
 class Object {
 public:
-  Object(const Material& mat) : material(mat) {}
+  Object(const Material& mat) : material(mat) {
+    material.classify();
+  }
   virtual Intersect rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const = 0;
+  virtual HitAttributes getAttributes(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const Intersect& hit) const = 0;
   
   Material material;
 };
@@ -0,0 +1,241 @@
+#include "octree.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int INITIAL_LEVEL = 4;
+const double ALBEDO_SCALE = 65536.0;
+
+// Whether the ray really crosses a box it enters at tEnter and leaves at tExit.
+// These distances come from repeated midpoints and their error grows with
+// distance, so a ray that only clips an edge is kept; the leaf test is exact
+bool crosses(float tEnter, float tExit) {
+    return tEnter <= tExit + 1e-4f * std::max(1.0f, std::fabs(tEnter)) && tExit >= 0;
+}
+
+glm::ivec3 childOffset(int child, int half) {
+    return glm::ivec3((child & 1) ? half : 0, (child & 2) ? half : 0, (child & 4) ? half : 0);
+}
+
+}
+
+VoxelOctree::VoxelOctree()
+  : rootMin(-(1 << (INITIAL_LEVEL - 1))), rootLevel(INITIAL_LEVEL) {
+    nodes.emplace_back();
+    std::fill(std::begin(nodes[0].children), std::end(nodes[0].children), -1);
+}
+
+void VoxelOctree::set(const glm::ivec3& cell, const Color& color, float albedo) {
+    auto leaf = leaves.find(cell);
+    if (leaf != leaves.end()) {
+        add(cell, leaf->second, -1);
+    }
+
+    grow(cell);
+    Leaf& stored = leaves[cell];
+    stored = Leaf{color, albedo};
+    add(cell, stored, 1);
+}
+
+void VoxelOctree::clear(const glm::ivec3& cell) {
+    auto leaf = leaves.find(cell);
+    if (leaf == leaves.end()) {
+        return;
+    }
+    add(cell, leaf->second, -1);
+    leaves.erase(leaf);
+}
+
+bool VoxelOctree::contains(const glm::ivec3& cell) const {
+    int size = 1 << rootLevel;
+    for (int axis = 0; axis < 3; axis++) {
+        if (cell[axis] < rootMin[axis] || cell[axis] >= rootMin[axis] + size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void VoxelOctree::grow(const glm::ivec3& cell) {
+    while (!contains(cell)) {
+        // Double the root towards the cell, the old root becomes one of its children
+        int size = 1 << rootLevel;
+        int child = 0;
+        glm::ivec3 newMin = rootMin;
+        for (int axis = 0; axis < 3; axis++) {
+            if (cell[axis] < rootMin[axis]) {
+                newMin[axis] -= size;
+                child |= 1 << axis;
+            }
+        }
+
+        Node root;
+        std::fill(std::begin(root.children), std::end(root.children), -1);
+        root.count = nodes[0].count;
+        root.sumR = nodes[0].sumR;
+        root.sumG = nodes[0].sumG;
+        root.sumB = nodes[0].sumB;
+        root.sumAlbedo = nodes[0].sumAlbedo;
+        if (nodes[0].count > 0) {
+            root.occupancy = uint8_t(1 << child);
+        }
+
+        nodes.push_back(nodes[0]);
+        root.children[child] = int32_t(nodes.size() - 1);
+        nodes[0] = root;
+
+        rootMin = newMin;
+        rootLevel++;
+    }
+}
+
+void VoxelOctree::add(const glm::ivec3& cell, const Leaf& leaf, int delta) {
+    int32_t index = 0;
+    int32_t parent = -1;
+    int parentChild = 0;
+    glm::ivec3 nodeMin = rootMin;
+
+    for (int level = rootLevel; level >= 1; level--) {
+        Node& node = nodes[index];
+        node.count += delta;
+        node.sumR += delta * int64_t(leaf.color.r);
+        node.sumG += delta * int64_t(leaf.color.g);
+        node.sumB += delta * int64_t(leaf.color.b);
+        node.sumAlbedo += delta * int64_t(std::llround(leaf.albedo * ALBEDO_SCALE));
+
+        if (parent >= 0) {
+            if (node.count > 0) {
+                nodes[parent].occupancy |= uint8_t(1 << parentChild);
+            } else {
+                nodes[parent].occupancy &= uint8_t(~(1 << parentChild));
+            }
+        }
+
+        int half = 1 << (level - 1);
+        int child = (cell.x >= nodeMin.x + half ? 1 : 0) |
+                    (cell.y >= nodeMin.y + half ? 2 : 0) |
+                    (cell.z >= nodeMin.z + half ? 4 : 0);
+
+        // Children of the last level are the cells themselves
+        if (level == 1) {
+            if (delta > 0) {
+                node.occupancy |= uint8_t(1 << child);
+            } else {
+                node.occupancy &= uint8_t(~(1 << child));
+            }
+            return;
+        }
+
+        if (node.children[child] < 0) {
+            Node created;
+            std::fill(std::begin(created.children), std::end(created.children), -1);
+            nodes.push_back(created);
+            nodes[index].children[child] = int32_t(nodes.size() - 1);
+        }
+
+        parent = index;
+        parentChild = child;
+        index = nodes[index].children[child];
+        nodeMin += childOffset(child, half);
+    }
+}
+
+bool VoxelOctree::traverse(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float footprint,
+                           const LeafTest& leafTest, VoxelHit& hit) const {
+    if (nodes[0].count == 0) {
+        return false;
+    }
+
+    // Per-axis distances to the root's slabs, sorted so that the ray always
+    // goes from tLow to tHigh. Children then only need the midpoints
+    glm::vec3 tLow, tHigh;
+    glm::vec3 direction = rayDirection;
+    glm::vec3 rootMax = glm::vec3(rootMin) + glm::vec3(float(1 << rootLevel));
+    for (int axis = 0; axis < 3; axis++) {
+        // A tiny component instead of zero keeps the distances finite. The
+        // nodes below pick near and far children from this same sign
+        if (std::fabs(direction[axis]) < 1e-9f) {
+            direction[axis] = 1e-9f;
+        }
+        float t1 = (float(rootMin[axis]) - rayOrigin[axis]) / direction[axis];
+        float t2 = (rootMax[axis] - rayOrigin[axis]) / direction[axis];
+        tLow[axis] = std::min(t1, t2);
+        tHigh[axis] = std::max(t1, t2);
+    }
+    return traverseNode(0, rootMin, rootLevel, tLow, tHigh, direction, footprint, leafTest, hit);
+}
+
+bool VoxelOctree::traverseNode(int32_t index, const glm::ivec3& nodeMin, int level, const glm::vec3& tLow,
+                               const glm::vec3& tHigh, const glm::vec3& rayDirection, float footprint,
+                               const LeafTest& leafTest, VoxelHit& hit) const {
+    const Node& node = nodes[index];
+    float tEnter = std::max(tLow.x, std::max(tLow.y, tLow.z));
+    float tExit = std::min(tHigh.x, std::min(tHigh.y, tHigh.z));
+    if (!crosses(tEnter, tExit)) {
+        return false;
+    }
+
+    // Far enough that the whole node is under the pixel footprint
+    if (footprint > 0.0f && float(1 << level) < footprint * tEnter) {
+        int axis = tLow.x == tEnter ? 0 : (tLow.y == tEnter ? 1 : 2);
+        hit.dist = tEnter;
+        hit.normal = glm::vec3(0.0f);
+        hit.normal[axis] = rayDirection[axis] > 0 ? -1.0f : 1.0f;
+        hit.color = Color(int(node.sumR / node.count), int(node.sumG / node.count), int(node.sumB / node.count));
+        hit.albedo = float(double(node.sumAlbedo) / (ALBEDO_SCALE * node.count));
+        hit.level = level;
+        return true;
+    }
+
+    // Occupied children the ray crosses, visited in the order it enters them.
+    // Along each axis a child takes the near or far half of the node's span
+    struct Candidate {
+        float tEnter;
+        float tExit;
+        int child;
+        glm::vec3 tLow;
+        glm::vec3 tHigh;
+    };
+    Candidate order[8];
+    int count = 0;
+
+    glm::vec3 tMid = (tLow + tHigh) * 0.5f;
+    for (int child = 0; child < 8; child++) {
+        if (!(node.occupancy & (1 << child))) {
+            continue;
+        }
+        Candidate candidate;
+        for (int axis = 0; axis < 3; axis++) {
+            bool upper = child & (1 << axis);
+            bool near = upper == (rayDirection[axis] < 0);
+            candidate.tLow[axis] = near ? tLow[axis] : tMid[axis];
+            candidate.tHigh[axis] = near ? tMid[axis] : tHigh[axis];
+        }
+        candidate.tEnter = std::max(candidate.tLow.x, std::max(candidate.tLow.y, candidate.tLow.z));
+        candidate.tExit = std::min(candidate.tHigh.x, std::min(candidate.tHigh.y, candidate.tHigh.z));
+        if (crosses(candidate.tEnter, candidate.tExit)) {
+            candidate.child = child;
+            order[count++] = candidate;
+        }
+    }
+    std::sort(order, order + count, [](const Candidate& a, const Candidate& b) {
+        return a.tEnter < b.tEnter;
+    });
+
+    int half = 1 << (level - 1);
+    for (int i = 0; i < count; i++) {
+        glm::ivec3 childMin = nodeMin + childOffset(order[i].child, half);
+        if (level == 1) {
+            if (leafTest(childMin, order[i].tEnter, order[i].tExit)) {
+                hit.level = 0;
+                return true;
+            }
+        } else if (traverseNode(node.children[order[i].child], childMin, level - 1, order[i].tLow, order[i].tHigh,
+                                rayDirection, footprint, leafTest, hit)) {
+            return true;
+        }
+    }
+    return false;
+}
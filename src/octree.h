@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "color.h"
+#include "scene.h"
+
+// Hit on the octree. For a coarse node it carries the node's averages
+struct VoxelHit {
+  float dist = 0.0f;
+  glm::vec3 normal{0.0f};
+  Color color;
+  float albedo = 0.0f;
+  int level = 0;  // 0 for a single cell, n for a node 2^n cells wide
+};
+
+// Sparse voxel octree over the cells of the block world. Every node keeps
+// an occupancy mask of its children, to skip empty space, and running sums
+// of the colour and albedo below it, so edits only touch one root-to-leaf
+// path and coarse levels can stand in for far geometry.
+class VoxelOctree {
+public:
+  VoxelOctree();
+
+  void set(const glm::ivec3& cell, const Color& color, float albedo);
+  void clear(const glm::ivec3& cell);
+
+  // Called for occupied cells in front-to-back order, with the distances at
+  // which the ray enters and leaves the cell. Returns true to stop there.
+  using LeafTest = std::function<bool(const glm::ivec3& cell, float tEnter, float tExit)>;
+
+  // Walk the octree front to back. A node whose width is below `footprint`
+  // times its distance is reported as a coarse hit (level > 0) without
+  // descending; footprint 0 always goes down to the cells.
+  bool traverse(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float footprint,
+                const LeafTest& leafTest, VoxelHit& hit) const;
+
+private:
+  struct Node {
+    int32_t children[8];
+    uint8_t occupancy = 0;  // bit i set when child i has any cell below it
+    int32_t count = 0;      // occupied cells below
+    // Integer sums, so adding and removing a cell cancels out exactly
+    // however many edits a large node goes through
+    int64_t sumR = 0;
+    int64_t sumG = 0;
+    int64_t sumB = 0;
+    int64_t sumAlbedo = 0;  // fixed point, in units of 1/65536
+  };
+
+  struct Leaf {
+    Color color;
+    float albedo;
+  };
+
+  bool contains(const glm::ivec3& cell) const;
+  void grow(const glm::ivec3& cell);
+  void add(const glm::ivec3& cell, const Leaf& leaf, int delta);
+  bool traverseNode(int32_t index, const glm::ivec3& nodeMin, int level, const glm::vec3& tLow,
+                    const glm::vec3& tHigh, const glm::vec3& rayDirection, float footprint,
+                    const LeafTest& leafTest, VoxelHit& hit) const;
+
+  std::vector<Node> nodes;
+  std::unordered_map<glm::ivec3, Leaf, CellHash> leaves;
+  glm::ivec3 rootMin;
+  int rootLevel;  // the root is 2^rootLevel cells wide
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "color.h"
+
+// Write a framebuffer as a binary PPM (P6) image
+inline void writePPM(const std::string& path, int width, int height, const std::vector<Color>& pixels) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Unable to open " + path + " for writing");
+    }
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (const Color& pixel : pixels) {
+        file.put(static_cast<char>(pixel.r));
+        file.put(static_cast<char>(pixel.g));
+        file.put(static_cast<char>(pixel.b));
+    }
+}
+
+// Read a binary PPM (P6) image written by writePPM
+inline std::vector<Color> readPPM(const std::string& path, int& width, int& height) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    int maxValue = 0;
+    if (!file || !(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255) {
+        throw std::runtime_error("Unable to read PPM image " + path);
+    }
+    file.get();
+
+    std::vector<Color> pixels(size_t(width) * height);
+    for (Color& pixel : pixels) {
+        unsigned char rgb[3];
+        if (!file.read(reinterpret_cast<char*>(rgb), 3)) {
+            throw std::runtime_error("Truncated PPM image " + path);
+        }
+        pixel = Color(int(rgb[0]), int(rgb[1]), int(rgb[2]));
+    }
+    return pixels;
+}
@@ -0,0 +1,108 @@
+#include "regression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "ppm.h"
+#include "print.h"
+
+namespace {
+
+struct Measurement {
+    std::vector<Color> pixels;
+    double raysPerSecond = 0.0;
+};
+
+Measurement measure(const RegressionScene& scene, int width, int height, const FrameRenderer& render, int repeats) {
+    scene.setUp();
+
+    Measurement result;
+    for (int i = 0; i < std::max(1, repeats); i++) {
+        std::vector<Color> pixels(size_t(width) * height);
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t rays = render(pixels);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        result.raysPerSecond = std::max(result.raysPerSecond, rays / std::max(elapsed.count(), 1e-9));
+        result.pixels = std::move(pixels);
+    }
+    return result;
+}
+
+}
+
+void recordBaselines(const std::vector<RegressionScene>& scenes, const std::string& dir, int width, int height,
+                     const FrameRenderer& render, const RegressionOptions& options) {
+    std::filesystem::create_directories(dir);
+
+    for (const RegressionScene& scene : scenes) {
+        Measurement result = measure(scene, width, height, render, options.repeats);
+        writePPM(dir + "/" + scene.name + ".ppm", width, height, result.pixels);
+
+        std::ofstream perf(dir + "/" + scene.name + ".perf");
+        if (!perf) {
+            throw std::runtime_error("Unable to write baseline for " + scene.name);
+        }
+        perf << result.raysPerSecond << "\n";
+
+        print("Recorded", scene.name, "at", result.raysPerSecond, "rays/s");
+    }
+}
+
+int checkBaselines(const std::vector<RegressionScene>& scenes, const std::string& dir, int width, int height,
+                   const FrameRenderer& render, const RegressionOptions& options) {
+    int failures = 0;
+
+    for (const RegressionScene& scene : scenes) {
+        int goldenWidth, goldenHeight;
+        std::vector<Color> golden = readPPM(dir + "/" + scene.name + ".ppm", goldenWidth, goldenHeight);
+        if (goldenWidth != width || goldenHeight != height) {
+            print("FAIL", scene.name, "- golden image is", goldenWidth, "x", goldenHeight);
+            failures++;
+            continue;
+        }
+
+        // rays/s baselines belong to the machine that recorded them and are not
+        // committed. Without one, only the image is compared
+        double baseline = 0.0;
+        std::ifstream perf(dir + "/" + scene.name + ".perf");
+        bool hasBaseline = static_cast<bool>(perf >> baseline);
+
+        Measurement result = measure(scene, width, height, render, options.repeats);
+
+        // Per-pixel metric: a pixel is off when any channel moves past the tolerance
+        size_t badPixels = 0;
+        int worst = 0;
+        for (size_t i = 0; i < golden.size(); i++) {
+            int diff = std::max({std::abs(int(golden[i].r) - int(result.pixels[i].r)),
+                                 std::abs(int(golden[i].g) - int(result.pixels[i].g)),
+                                 std::abs(int(golden[i].b) - int(result.pixels[i].b))});
+            worst = std::max(worst, diff);
+            if (diff > options.tolerance) {
+                badPixels++;
+            }
+        }
+
+        float badFraction = float(badPixels) / golden.size();
+        bool imageOk = badFraction <= options.maxBadPixels;
+        bool perfOk = !hasBaseline || result.raysPerSecond >= baseline * (1.0 - options.perfMargin);
+
+        if (!imageOk) {
+            writePPM(dir + "/" + scene.name + ".actual.ppm", width, height, result.pixels);
+        }
+
+        print(imageOk && perfOk ? "PASS" : "FAIL", scene.name,
+              "- pixels off:", badPixels, "worst diff:", worst,
+              "- rays/s:", result.raysPerSecond,
+              "baseline:", hasBaseline ? std::to_string(static_cast<long long>(baseline)) : std::string("none"));
+        if (!imageOk || !perfOk) {
+            failures++;
+        }
+    }
+
+    return failures;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "color.h"
+
+// A scene the regression suite renders headless, at a fixed camera
+struct RegressionScene {
+  std::string name;
+  std::function<void()> setUp;
+};
+
+// Render the current scene into `pixels` and return how many rays were traced
+using FrameRenderer = std::function<uint64_t(std::vector<Color>& pixels)>;
+
+struct RegressionOptions {
+  int tolerance = 8;             // largest per-channel difference a pixel may have
+  float maxBadPixels = 0.001f;   // fraction of pixels allowed past the tolerance
+  float perfMargin = 0.2f;       // allowed drop in rays/s below the baseline
+  int repeats = 3;               // timed renders per scene, the fastest one counts
+};
+
+// Golden images and rays/s baselines live in `dir` as <name>.ppm and <name>.perf.
+// recordBaselines overwrites them; checkBaselines compares against them and
+// returns the number of failed scenes.
+void recordBaselines(const std::vector<RegressionScene>& scenes, const std::string& dir, int width, int height,
+                     const FrameRenderer& render, const RegressionOptions& options);
+int checkBaselines(const std::vector<RegressionScene>& scenes, const std::string& dir, int width, int height,
+                   const FrameRenderer& render, const RegressionOptions& options);
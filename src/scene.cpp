@@ -0,0 +1,98 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+struct MaterialGroup {
+    Material material;
+    std::vector<Block> boxes;
+};
+
+bool isOnGrid(const glm::vec3& p) {
+    return glm::floor(p) == p;
+}
+
+// Merge runs of boxes that touch along `axis` and share the same cross-section
+void mergeAlong(std::vector<Block>& boxes, int axis) {
+    int a = (axis + 1) % 3;
+    int b = (axis + 2) % 3;
+
+    auto key = [&](const Block& box) {
+        return std::make_tuple(box.minCorner[a], box.maxCorner[a],
+                               box.minCorner[b], box.maxCorner[b],
+                               box.minCorner[axis]);
+    };
+    std::sort(boxes.begin(), boxes.end(), [&](const Block& l, const Block& r) {
+        return key(l) < key(r);
+    });
+
+    std::vector<Block> merged;
+    for (const Block& box : boxes) {
+        if (!merged.empty()) {
+            Block& last = merged.back();
+            bool sameSection = last.minCorner[a] == box.minCorner[a] && last.maxCorner[a] == box.maxCorner[a] &&
+                               last.minCorner[b] == box.minCorner[b] && last.maxCorner[b] == box.maxCorner[b];
+            if (sameSection && last.maxCorner[axis] == box.minCorner[axis]) {
+                last.maxCorner[axis] = box.maxCorner[axis];
+                continue;
+            }
+        }
+        merged.push_back(box);
+    }
+    boxes.swap(merged);
+}
+
+// True when every cell touching the box from outside is an opaque block
+bool isHidden(const Block& box, const std::function<bool(const glm::ivec3&)>& isOpaque) {
+    if (!isOnGrid(box.minCorner) || !isOnGrid(box.maxCorner)) {
+        return false;
+    }
+
+    glm::ivec3 lo(box.minCorner);
+    glm::ivec3 hi(box.maxCorner);
+    for (int x = lo.x - 1; x <= hi.x; x++) {
+        for (int y = lo.y - 1; y <= hi.y; y++) {
+            for (int z = lo.z - 1; z <= hi.z; z++) {
+                int outside = (x < lo.x || x >= hi.x) + (y < lo.y || y >= hi.y) + (z < lo.z || z >= hi.z);
+                // Only face neighbours matter, edges and corners never cover a face
+                if (outside == 1 && !isOpaque(glm::ivec3(x, y, z))) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+std::vector<Block> mergeBlocks(const std::vector<Block>& blocks, const std::function<bool(const glm::ivec3&)>& isOpaque) {
+    std::vector<MaterialGroup> groups;
+    for (const Block& block : blocks) {
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const MaterialGroup& g) {
+            return g.material == block.material;
+        });
+        if (group == groups.end()) {
+            groups.push_back(MaterialGroup{block.material, {}});
+            group = groups.end() - 1;
+        }
+        group->boxes.push_back(block);
+    }
+
+    std::vector<Block> merged;
+    for (MaterialGroup& group : groups) {
+        // Rows along x, then slabs along y, then blocks along z
+        for (int axis = 0; axis < 3; axis++) {
+            mergeAlong(group.boxes, axis);
+        }
+
+        for (const Block& box : group.boxes) {
+            if (!isHidden(box, isOpaque)) {
+                merged.push_back(box);
+            }
+        }
+    }
+    return merged;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "material.h"
+
+// A box of the block world with its material. Unit blocks sit on the
+// integer grid; a block may be smaller than its cell (e.g. slabs).
+struct Block {
+  glm::vec3 minCorner;
+  glm::vec3 maxCorner;
+  Material material;
+};
+
+struct CellHash {
+  size_t operator()(const glm::ivec3& cell) const {
+    return (size_t(cell.x) * 73856093) ^ (size_t(cell.y) * 19349663) ^ (size_t(cell.z) * 83492791);
+  }
+};
+
+// Scene compile pass. Greedily merges adjacent same-material blocks into
+// larger boxes and drops boxes whose face neighbours are all opaque, as
+// reported by `isOpaque` for a grid cell.
+std::vector<Block> mergeBlocks(const std::vector<Block>& blocks, const std::function<bool(const glm::ivec3&)>& isOpaque);
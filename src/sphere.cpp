@@ -22,9 +22,13 @@ Intersect Sphere::rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayD
     return Intersect{false};
   }
 
-  glm::vec3 point = rayOrigin + dist * rayDirection;
+  return Intersect{true, dist};
+}
+
+HitAttributes Sphere::getAttributes(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const Intersect& hit) const {
+  glm::vec3 point = rayOrigin + hit.dist * rayDirection;
   glm::vec3 normal = glm::normalize(point - center);
-  return Intersect{true, dist, point, normal};
+  return HitAttributes{point, normal};
 }
 
 
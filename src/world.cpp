@@ -0,0 +1,324 @@
+#include "world.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+
+namespace {
+
+int floorDiv(int value, int divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+glm::ivec3 chunkOf(const glm::ivec3& cell) {
+    return glm::ivec3(floorDiv(cell.x, World::CHUNK_SIZE), floorDiv(cell.y, World::CHUNK_SIZE), floorDiv(cell.z, World::CHUNK_SIZE));
+}
+
+glm::ivec3 cellOf(const glm::vec3& p) {
+    return glm::ivec3(glm::floor(p));
+}
+
+// Average colour of a material, the one of its texture when it has one
+Color averageColor(const Material& mat) {
+    if (mat.texture == nullptr) {
+        return mat.diffuse;
+    }
+
+    static std::unordered_map<const SDL_Surface*, Color> cache;
+    auto cached = cache.find(mat.texture);
+    if (cached != cache.end()) {
+        return cached->second;
+    }
+
+    const SDL_Surface* texture = mat.texture;
+    const Uint8* pixels = static_cast<const Uint8*>(texture->pixels);
+    uint64_t r = 0, g = 0, b = 0;
+    for (int y = 0; y < texture->h; y++) {
+        for (int x = 0; x < texture->w; x++) {
+            const Uint8* texel = pixels + y * texture->pitch + x * texture->format->BytesPerPixel;
+            r += texel[0];
+            g += texel[1];
+            b += texel[2];
+        }
+    }
+
+    uint64_t count = std::max(1, texture->w * texture->h);
+    Color average(int(r / count), int(g / count), int(b / count));
+    cache[mat.texture] = average;
+    return average;
+}
+
+// Slab test returning the entry and exit distances of the ray
+bool rayBox(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& rayOrigin, const glm::vec3& invDirection,
+            float& tEnter, float& tExit) {
+    tEnter = -std::numeric_limits<float>::infinity();
+    tExit = std::numeric_limits<float>::infinity();
+    for (int axis = 0; axis < 3; axis++) {
+        float t1 = (boxMin[axis] - rayOrigin[axis]) * invDirection[axis];
+        float t2 = (boxMax[axis] - rayOrigin[axis]) * invDirection[axis];
+        if (std::isnan(t1) || std::isnan(t2)) {
+            // Parallel ray sitting on a slab boundary
+            continue;
+        }
+        tEnter = std::max(tEnter, std::min(t1, t2));
+        tExit = std::min(tExit, std::max(t1, t2));
+    }
+    return tEnter <= tExit && tExit >= 0;
+}
+
+}
+
+void World::addBlock(const glm::vec3& minCorner, const glm::vec3& maxCorner, const Material& mat) {
+    glm::ivec3 cell = cellOf(minCorner);
+    glm::ivec3 key = chunkOf(cell);
+
+    Chunk& chunk = chunks[key];
+    if (chunk.blocks.empty() && chunk.boxes.empty()) {
+        chunkMin = chunks.size() == 1 ? key : glm::min(chunkMin, key);
+        chunkMax = chunks.size() == 1 ? key : glm::max(chunkMax, key);
+    }
+    chunk.blocks[cell] = Block{minCorner, maxCorner, mat};
+    octree.set(cell, averageColor(mat), mat.albedo);
+    markDirty(cell);
+}
+
+void World::placeBlock(const glm::ivec3& cell, const Material& mat) {
+    glm::vec3 minCorner(cell);
+    addBlock(minCorner, minCorner + glm::vec3(1.0f), mat);
+}
+
+bool World::removeBlock(const glm::ivec3& cell) {
+    Chunk* chunk = chunkAt(chunkOf(cell));
+    if (!chunk || chunk->blocks.erase(cell) == 0) {
+        return false;
+    }
+    octree.clear(cell);
+    markDirty(cell);
+    return true;
+}
+
+bool World::setMaterial(const glm::ivec3& cell, const Material& mat) {
+    Chunk* chunk = chunkAt(chunkOf(cell));
+    if (!chunk) {
+        return false;
+    }
+
+    auto block = chunk->blocks.find(cell);
+    if (block == chunk->blocks.end()) {
+        return false;
+    }
+    block->second.material = mat;
+    octree.set(cell, averageColor(mat), mat.albedo);
+    markDirty(cell);
+    return true;
+}
+
+void World::update() {
+    if (dirty.empty()) {
+        return;
+    }
+
+    std::sort(dirty.begin(), dirty.end(), [](const glm::ivec3& a, const glm::ivec3& b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    });
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    bool removedChunk = false;
+    for (const glm::ivec3& key : dirty) {
+        auto chunk = chunks.find(key);
+        if (chunk == chunks.end()) {
+            continue;
+        }
+        if (chunk->second.blocks.empty()) {
+            chunks.erase(chunk);
+            removedChunk = true;
+            continue;
+        }
+        rebuild(chunk->second);
+    }
+    dirty.clear();
+
+    // Only shrink the traversal range when a chunk went away
+    if (removedChunk) {
+        chunkMin = glm::ivec3(0);
+        chunkMax = glm::ivec3(-1);
+        bool first = true;
+        for (const auto& [key, chunk] : chunks) {
+            chunkMin = first ? key : glm::min(chunkMin, key);
+            chunkMax = first ? key : glm::max(chunkMax, key);
+            first = false;
+        }
+    }
+}
+
+Object* World::intersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, Intersect& hit,
+                         const Object* ignore, float minDist) const {
+    hit = Intersect{false, std::numeric_limits<float>::infinity()};
+    if (chunks.empty()) {
+        return nullptr;
+    }
+
+    glm::vec3 invDirection = 1.0f / rayDirection;
+    glm::vec3 worldMin = glm::vec3(chunkMin * CHUNK_SIZE);
+    glm::vec3 worldMax = glm::vec3((chunkMax + glm::ivec3(1)) * CHUNK_SIZE);
+
+    float tEnter, tExit;
+    if (!rayBox(worldMin, worldMax, rayOrigin, invDirection, tEnter, tExit)) {
+        return nullptr;
+    }
+
+    // Walk the chunk grid front to back (3D DDA), starting where the ray enters the world
+    float tStart = std::max(tEnter, 0.0f);
+    glm::vec3 start = rayOrigin + rayDirection * tStart;
+    glm::ivec3 key = glm::clamp(chunkOf(cellOf(start)), chunkMin, chunkMax);
+
+    glm::ivec3 step;
+    glm::vec3 tNext;
+    glm::vec3 tDelta;
+    for (int axis = 0; axis < 3; axis++) {
+        step[axis] = rayDirection[axis] > 0 ? 1 : -1;
+        float boundary = float((key[axis] + (step[axis] > 0 ? 1 : 0)) * CHUNK_SIZE);
+        tNext[axis] = rayDirection[axis] != 0 ? (boundary - rayOrigin[axis]) * invDirection[axis] : std::numeric_limits<float>::infinity();
+        tDelta[axis] = rayDirection[axis] != 0 ? CHUNK_SIZE * std::abs(invDirection[axis]) : std::numeric_limits<float>::infinity();
+    }
+
+    Object* hitObject = nullptr;
+    while (true) {
+        auto chunk = chunks.find(key);
+        float tChunkIn, tChunkOut;
+        if (chunk != chunks.end() &&
+            rayBox(chunk->second.boundsMin, chunk->second.boundsMax, rayOrigin, invDirection, tChunkIn, tChunkOut) &&
+            tChunkIn < hit.dist) {
+            for (const auto& box : chunk->second.boxes) {
+                if (box.get() == ignore) {
+                    continue;
+                }
+                Intersect i = box->rayIntersect(rayOrigin, rayDirection);
+                if (i.isIntersecting && i.dist < hit.dist && i.dist > minDist) {
+                    hit = i;
+                    hitObject = box.get();
+                }
+            }
+        }
+
+        // Boxes never leave their chunk, so nothing further on can be closer
+        int axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+        if (hitObject && hit.dist <= tNext[axis]) {
+            break;
+        }
+
+        key[axis] += step[axis];
+        tNext[axis] += tDelta[axis];
+        if (key[axis] < chunkMin[axis] || key[axis] > chunkMax[axis]) {
+            break;
+        }
+    }
+
+    return hitObject;
+}
+
+Object* World::intersectLod(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float footprint,
+                            Intersect& hit, VoxelHit& voxel) const {
+    hit = Intersect{false, std::numeric_limits<float>::infinity()};
+    Object* hitObject = nullptr;
+
+    // At a cell, the box covering it only counts when the ray enters that box
+    // inside this cell; otherwise a later cell along the ray will report it
+    auto leafTest = [&](const glm::ivec3& cell, float tEnter, float tExit) {
+        auto chunk = chunks.find(chunkOf(cell));
+        if (chunk == chunks.end()) {
+            return false;
+        }
+        auto owner = chunk->second.owners.find(cell);
+        if (owner == chunk->second.owners.end()) {
+            return false;
+        }
+
+        // The cell bounds come from repeated midpoints, so their error grows with distance
+        const float epsilon = 1e-4f * std::max(1.0f, std::fabs(tEnter));
+        Intersect i = owner->second->rayIntersect(rayOrigin, rayDirection);
+        if (!i.isIntersecting || i.dist < tEnter - epsilon || i.dist > tExit + epsilon) {
+            return false;
+        }
+        hit = i;
+        hitObject = owner->second;
+        return true;
+    };
+
+    if (octree.traverse(rayOrigin, rayDirection, footprint, leafTest, voxel) && !hitObject) {
+        hit = Intersect{true, voxel.dist};
+    }
+    return hitObject;
+}
+
+size_t World::primitiveCount() const {
+    size_t count = 0;
+    for (const auto& [key, chunk] : chunks) {
+        count += chunk.boxes.size();
+    }
+    return count;
+}
+
+World::Chunk* World::chunkAt(const glm::ivec3& key) {
+    auto chunk = chunks.find(key);
+    return chunk == chunks.end() ? nullptr : &chunk->second;
+}
+
+const Block* World::blockAt(const glm::ivec3& cell) const {
+    auto chunk = chunks.find(chunkOf(cell));
+    if (chunk == chunks.end()) {
+        return nullptr;
+    }
+    auto block = chunk->second.blocks.find(cell);
+    return block == chunk->second.blocks.end() ? nullptr : &block->second;
+}
+
+bool World::isOpaque(const glm::ivec3& cell) const {
+    const Block* block = blockAt(cell);
+    return block &&
+           block->minCorner == glm::vec3(cell) &&
+           block->maxCorner == glm::vec3(cell) + glm::vec3(1.0f) &&
+           block->material.transparency <= 0.0f;
+}
+
+void World::markDirty(const glm::ivec3& cell) {
+    // Neighbouring chunks may hide or reveal boxes that touch this cell
+    dirty.push_back(chunkOf(cell));
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side : {-1, 1}) {
+            glm::ivec3 neighbour = cell;
+            neighbour[axis] += side;
+            dirty.push_back(chunkOf(neighbour));
+        }
+    }
+}
+
+void World::rebuild(Chunk& chunk) {
+    std::vector<Block> blocks;
+    blocks.reserve(chunk.blocks.size());
+    for (const auto& [cell, block] : chunk.blocks) {
+        blocks.push_back(block);
+    }
+
+    chunk.boxes.clear();
+    chunk.owners.clear();
+    chunk.boundsMin = glm::vec3(std::numeric_limits<float>::infinity());
+    chunk.boundsMax = glm::vec3(-std::numeric_limits<float>::infinity());
+
+    for (const Block& box : mergeBlocks(blocks, [this](const glm::ivec3& cell) { return isOpaque(cell); })) {
+        chunk.boxes.push_back(std::make_unique<Cube>(box.minCorner, box.maxCorner, box.material));
+
+        glm::ivec3 first = cellOf(box.minCorner);
+        glm::ivec3 last = glm::ivec3(glm::ceil(box.maxCorner)) - glm::ivec3(1);
+        for (int x = first.x; x <= last.x; x++) {
+            for (int y = first.y; y <= last.y; y++) {
+                for (int z = first.z; z <= last.z; z++) {
+                    chunk.owners[glm::ivec3(x, y, z)] = chunk.boxes.back().get();
+                }
+            }
+        }
+        chunk.boundsMin = glm::min(chunk.boundsMin, box.minCorner);
+        chunk.boundsMax = glm::max(chunk.boundsMax, box.maxCorner);
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "cube.h"
+#include "octree.h"
+#include "scene.h"
+
+// Block world, editable at runtime. Blocks are grouped in chunks of
+// CHUNK_SIZE^3 cells and each chunk owns the merged boxes rays are tested
+// against. Edits only mark chunks dirty and update() re-merges just those,
+// so the cost of an edit does not grow with the size of the world.
+class World {
+public:
+  static const int CHUNK_SIZE = 8;
+
+  // Add a block occupying the cell of its min corner. It must fit in that cell
+  void addBlock(const glm::vec3& minCorner, const glm::vec3& maxCorner, const Material& mat);
+
+  void placeBlock(const glm::ivec3& cell, const Material& mat);
+  bool removeBlock(const glm::ivec3& cell);
+  bool setMaterial(const glm::ivec3& cell, const Material& mat);
+
+  // Rebuild the chunks edited since the last update
+  void update();
+
+  // Closest hit further than `minDist`, skipping `ignore`. The returned
+  // object stays valid until the next update()
+  Object* intersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, Intersect& hit,
+                    const Object* ignore = nullptr, float minDist = -std::numeric_limits<float>::infinity()) const;
+
+  // Like intersect() with no ignored object, but walks the voxel octree and
+  // may stop at a coarse node narrower than `footprint` times its distance.
+  // Such hits come back with a null object and the node averages in `voxel`
+  Object* intersectLod(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float footprint,
+                       Intersect& hit, VoxelHit& voxel) const;
+
+  size_t primitiveCount() const;
+
+private:
+  struct Chunk {
+    std::unordered_map<glm::ivec3, Block, CellHash> blocks;
+    std::vector<std::unique_ptr<Cube>> boxes;
+    std::unordered_map<glm::ivec3, Cube*, CellHash> owners;  // box covering each cell
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+  };
+
+  Chunk* chunkAt(const glm::ivec3& key);
+  const Block* blockAt(const glm::ivec3& cell) const;
+  bool isOpaque(const glm::ivec3& cell) const;
+  void markDirty(const glm::ivec3& cell);
+  void rebuild(Chunk& chunk);
+
+  std::unordered_map<glm::ivec3, Chunk, CellHash> chunks;
+  VoxelOctree octree;
+  std::vector<glm::ivec3> dirty;
+  glm::ivec3 chunkMin{0};
+  glm::ivec3 chunkMax{-1};
+};